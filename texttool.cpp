@@ -7,28 +7,79 @@
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <type_traits>
 
 // imath
 #include <Imath/ImathMatrix.h>
 #include <Imath/ImathVec.h>
+#include <Imath/half.h>
 
 // openimageio
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/typedesc.h>
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/fmath.h>
+#include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/timer.h>
+#include <OpenImageIO/ustring.h>
 
 #include <OpenImageIO/imagebuf.h>
+#include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/imagebufalgo_util.h>
+#include <OpenImageIO/simd.h>
+
+// freetype
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/mman.h>
+#  include <sys/resource.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif
 
 using namespace OIIO;
 
 // prints
+static std::mutex&
+print_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
 template <typename T>
 static void
 print_info(std::string param, const T& value = T()) {
+    std::lock_guard<std::mutex> lock(print_mutex());
     std::cout << "info: " << param << value << std::endl;
 }
 
@@ -40,6 +91,7 @@ print_info(std::string param) {
 template <typename T>
 static void
 print_warning(std::string param, const T& value = T()) {
+    std::lock_guard<std::mutex> lock(print_mutex());
     std::cout << "warning: " << param << value << std::endl;
 }
 
@@ -51,6 +103,7 @@ print_warning(std::string param) {
 template <typename T>
 static void
 print_error(std::string param, const T& value = T()) {
+    std::lock_guard<std::mutex> lock(print_mutex());
     std::cerr << "error: " << param << value << std::endl;
 }
 
@@ -59,7 +112,12 @@ print_error(std::string param) {
     print_error<std::string>(param);
 }
 
+// version, part of the output cache key
+static const char* texttool_version = "1.1.0";
+
 // text tool
+struct TemplatePlan;
+
 struct TextTool
 {
     bool help = false;
@@ -67,16 +125,55 @@ struct TextTool
     std::string title;
     std::string subtitle;
     std::string outputfile;
+    std::string inputfile;
     std::string gradient;
+    std::string batchfile;
+    std::string benchmarkfile;
+    std::string statsfile;
+    std::string serve;
+    Imath::Vec2<int> servemaxsize = Imath::Vec2<int>(16384, 16384); // largest card a request may ask for
+    std::string cachedir;
+    int cachesize = 1024;
+    int platememory = 512;
+    int platefiles = 100;
+    std::string templatefile;
+    std::map<std::string, std::string> fields;
+    std::shared_ptr<const TemplatePlan> plan; // compiled once from templatefile
+    std::string format;
+    std::string compression; // fast, small or a compression attribute, empty for the format default
+    int quality = 0;
+    std::string font = "Roboto.ttf";
+    std::string fontfile;
     Imath::Vec3<float> background = Imath::Vec3<float>(0.0f, 0.0f, 0.0f);
     Imath::Vec3<float> color = Imath::Vec3<float>(1.0f, 1.0f, 1.0f);
     Imath::Vec2<int> size = Imath::Vec2<int>(1024, 1024);
+    int threads = 0;
+    int glyphcache = 64;
+    int layercache = 64;
+    int stream = 0;
+    int writequeue = 1;
+    bool dither = false;
+    bool sequence = false;
+    Imath::Vec2<int> frames = Imath::Vec2<int>(0, 0); // first and last frame of the sequence
+    int fps = 24;
     bool debug;
     int code = EXIT_SUCCESS;
 };
 
 static TextTool tool;
 
+// text card
+struct TextCard
+{
+    std::string title;
+    std::string subtitle;
+    std::string gradient;
+    std::string outputfile;
+    std::string inputfile; // plate the text is composited onto, a new canvas if empty
+    Imath::Vec2<int> size;
+    std::map<std::string, std::string> fields; // template fields by lowercase name
+};
+
 // --title
 static int
 set_title(int argc, const char* argv[])
@@ -111,16 +208,271 @@ set_outputfile(int argc, const char* argv[])
     return 0;
 }
 
-// --size
+// --inputfile
 static int
-set_size(int argc, const char* argv[])
+set_inputfile(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.inputfile = argv[1];
+    return 0;
+}
+
+// --batch
+static int
+set_batch(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.batchfile = argv[1];
+    return 0;
+}
+
+// --template
+static int
+set_template(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.templatefile = argv[1];
+    return 0;
+}
+
+// --field
+static int
+set_field(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    std::string field = argv[1];
+    size_t equal = field.find('=');
+    if (equal == std::string::npos || equal == 0) {
+        print_error("could not parse field, expected KEY=VALUE: ", field);
+        return 1;
+    }
+    tool.fields[Strutil::lower(field.substr(0, equal))] = field.substr(equal + 1);
+    return 0;
+}
+
+// --sequence
+static int
+set_sequence(int argc, const char* argv[])
 {
     OIIO_DASSERT(argc == 2);
     std::istringstream iss(argv[1]);
-    iss >> tool.size.x;
+    iss >> tool.frames.x;
+    iss.ignore(); // Ignore the dash
+    iss >> tool.frames.y;
+    if (iss.fail() || tool.frames.x < 0 || tool.frames.y < tool.frames.x) {
+        print_error("could not parse sequence from string, expected start-end: ", argv[1]);
+        return 1;
+    }
+    tool.sequence = true;
+    return 0;
+}
+
+// --fps
+static int
+set_fps(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.fps = Strutil::stoi(argv[1]);
+    if (tool.fps <= 0) {
+        print_error("could not parse fps from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --format
+static int
+set_format(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    std::string format = Strutil::lower(argv[1]);
+    if (format != "uint8" && format != "uint10" && format != "uint16" && format != "half" && format != "float") {
+        print_error("unknown format, available options are uint8, uint10, uint16, half, float: ", argv[1]);
+        return 1;
+    }
+    tool.format = format;
+    return 0;
+}
+
+// --compression
+static int
+set_compression(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.compression = Strutil::lower(argv[1]);
+    return 0;
+}
+
+// --quality
+static int
+set_quality(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.quality = Strutil::stoi(argv[1]);
+    if (tool.quality < 1 || tool.quality > 100) {
+        print_error("could not parse quality from string, expected 1 to 100: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --stream
+static int
+set_stream(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.stream = Strutil::stoi(argv[1]);
+    if (tool.stream < 0) {
+        print_error("could not parse stream rows from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --write-queue
+static int
+set_writequeue(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.writequeue = Strutil::stoi(argv[1]);
+    if (tool.writequeue < 0) {
+        print_error("could not parse write queue from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --threads
+static int
+set_threads(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.threads = Strutil::stoi(argv[1]);
+    if (tool.threads < 0) {
+        print_error("could not parse threads from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --benchmark
+static int
+set_benchmark(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.benchmarkfile = argv[1];
+    return 0;
+}
+
+// --stats-json
+static int
+set_statsfile(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.statsfile = argv[1];
+    return 0;
+}
+
+// --serve
+static int
+set_serve(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.serve = argv[1];
+    return 0;
+}
+
+// --cache-dir
+static int
+set_cachedir(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.cachedir = argv[1];
+    return 0;
+}
+
+// --cache-size
+static int
+set_cachesize(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.cachesize = Strutil::stoi(argv[1]);
+    if (tool.cachesize < 0) {
+        print_error("could not parse cache size from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --plate-cache-memory
+static int
+set_platememory(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.platememory = Strutil::stoi(argv[1]);
+    if (tool.platememory <= 0) {
+        print_error("could not parse plate cache memory from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --plate-cache-files
+static int
+set_platefiles(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.platefiles = Strutil::stoi(argv[1]);
+    if (tool.platefiles <= 0) {
+        print_error("could not parse plate cache files from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --glyphcache
+static int
+set_glyphcache(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.glyphcache = Strutil::stoi(argv[1]);
+    if (tool.glyphcache < 0) {
+        print_error("could not parse glyph cache size from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// --layercache
+static int
+set_layercache(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    tool.layercache = Strutil::stoi(argv[1]);
+    if (tool.layercache < 0) {
+        print_error("could not parse layer cache size from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+// utils - size
+static bool
+parse_size(const std::string& str, Imath::Vec2<int>& size)
+{
+    std::istringstream iss(str);
+    iss >> size.x;
     iss.ignore(); // Ignore the comma
-    iss >> tool.size.y;
-    if (iss.fail()) {
+    iss >> size.y;
+    return !iss.fail();
+}
+
+// --size
+static int
+set_size(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    if (!parse_size(argv[1], tool.size)) {
         print_error("could not parse size from string: ", argv[1]);
         return 1;
     } else {
@@ -128,6 +480,18 @@ set_size(int argc, const char* argv[])
     }
 }
 
+// --serve-max-size
+static int
+set_serve_max_size(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    if (!parse_size(argv[1], tool.servemaxsize) || tool.servemaxsize.x <= 0 || tool.servemaxsize.y <= 0) {
+        print_error("could not parse serve max size from string: ", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
 // --help
 static void
 print_help(ArgParse& ap)
@@ -141,6 +505,43 @@ std::string font_path(const std::string& font)
     return Filesystem::parent_path(Sysutil::this_program_path()) + "/fonts/" + font;
 }
 
+// returns a unique temporary path next to outputfile, keeping the extension so
+// that the image writer is still chosen from it
+static std::string
+temp_path(const std::string& outputfile)
+{
+    return Filesystem::unique_path(outputfile + ".%%%%%%%%.tmp" + Filesystem::extension(outputfile));
+}
+
+// renames a complete tempfile over outputfile. outputs are never truncated in
+// place, so files hard linked to them such as input plates keep their
+// contents
+static bool
+replace_file(const std::string& tempfile, const std::string& outputfile)
+{
+    std::string error;
+    if (!Filesystem::rename(tempfile, outputfile, error)) {
+        Filesystem::remove(tempfile, error);
+        print_error("could not replace output file: ", outputfile);
+        return false;
+    }
+    return true;
+}
+
+// writes imagebuf to a temporary file and renames it over outputfile
+static bool
+write_image(const ImageBuf& imagebuf, const std::string& outputfile)
+{
+    std::string tempfile = temp_path(outputfile);
+    if (!imagebuf.write(tempfile)) {
+        std::string error;
+        Filesystem::remove(tempfile, error);
+        print_error("could not write output file", imagebuf.geterror());
+        return false;
+    }
+    return replace_file(tempfile, outputfile);
+}
+
 // utils - drawing
 Imath::Vec3<float> rgb_from_hsv(const Imath::Vec3<float>& hsv) {
     float hue = hsv.x;
@@ -179,37 +580,3813 @@ Imath::Vec3<float> rgb_from_hsv(const Imath::Vec3<float>& hsv) {
     return Imath::Vec3<float>(r, g, b);
 }
 
-void draw_gradient(ImageBuf &imagebuf, ROI roi,  Imath::Vec3<float> startcolor,  Imath::Vec3<float> endcolor) {
-    for (int y = roi.ybegin; y < roi.yend; ++y) {
-        float blend = static_cast<float>(y - roi.ybegin) / (roi.height() - 1);
-        float r = (1 - blend) * startcolor[0] + blend * endcolor[0];
-        float g = (1 - blend) * startcolor[1] + blend * endcolor[1];
-        float b = (1 - blend) * startcolor[2] + blend * endcolor[2];
-        for (int x = roi.xbegin; x < roi.xend; ++x) {
-            imagebuf.setpixel(x, y, {r, g, b, 1.0f});
+// utils - pixels
+
+// calls func with a null pointer of the local pixel type of imagebuf, returns
+// false if pixels are not local and contiguous or of an unsupported type
+template <typename F>
+static bool
+dispatch_pixels(const ImageBuf& imagebuf, F func)
+{
+    if (!imagebuf.localpixels() || imagebuf.pixel_stride() != stride_t(imagebuf.spec().pixel_bytes())) {
+        return false;
+    }
+    switch (imagebuf.spec().format.basetype) {
+        case TypeDesc::UINT8: func(static_cast<unsigned char*>(nullptr)); return true;
+        case TypeDesc::UINT16: func(static_cast<unsigned short*>(nullptr)); return true;
+        case TypeDesc::HALF: func(static_cast<half*>(nullptr)); return true;
+        case TypeDesc::FLOAT: func(static_cast<float*>(nullptr)); return true;
+        default: return false;
+    }
+}
+
+// utils - gradient
+struct GradientStop
+{
+    float position = 0.0f;
+    Imath::Vec3<float> color;
+};
+
+// vertical and horizontal gradients run from the top and left edges, linear
+// gradients follow angle in degrees clockwise from up (90 right, 180 down),
+// diagonal runs from the top left to the bottom right corner and radial from
+// the center to the farthest corner
+struct Gradient
+{
+    enum Mode { Vertical, Horizontal, Diagonal, Linear, Radial };
+    Mode mode = Vertical;
+    float angle = 180.0f;
+    std::vector<GradientStop> stops; // sorted by position, empty for none
+};
+
+// returns the gradient color at t, clamped to the first and last stop
+static Imath::Vec3<float>
+gradient_color(const Gradient& gradient, float t)
+{
+    const std::vector<GradientStop>& stops = gradient.stops;
+    if (t <= stops.front().position) {
+        return stops.front().color;
+    }
+    for (size_t i = 1; i < stops.size(); ++i) {
+        if (t <= stops[i].position) {
+            const GradientStop& start = stops[i - 1];
+            const GradientStop& end = stops[i];
+            float range = end.position - start.position;
+            float blend = range > 0.0f ? (t - start.position) / range : 1.0f;
+            return Imath::Vec3<float>(
+                (1 - blend) * start.color[0] + blend * end.color[0],
+                (1 - blend) * start.color[1] + blend * end.color[1],
+                (1 - blend) * start.color[2] + blend * end.color[2]
+            );
         }
     }
+    return stops.back().color;
 }
 
-// main
-int 
-main( int argc, const char * argv[])
+// 8x8 bayer matrix for ordered dithering
+static const unsigned char bayer_matrix[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+// returns the ordered dither offset at canvas position x, y in [-0.5, 0.5)
+// of one quantization step, anchored to the canvas so bands line up
+static inline float
+dither_offset(int x, int y)
 {
-    // Helpful for debugging to make sure that any crashes dump a stack
-    // trace.
-    Sysutil::setup_crash_stacktrace("stdout");
+    return (bayer_matrix[y & 7][x & 7] + 0.5f) / 64.0f - 0.5f;
+}
 
-    Filesystem::convert_native_arguments(argc, (const char**)argv);
-    ArgParse ap;
+// converts rgb plus opaque channels to T, offset is added to rgb before
+// quantization
+template <typename T, int NCHANNELS>
+static inline void
+gradient_pixel(T* dst, const float* color, float offset)
+{
+    for (int c = 0; c < NCHANNELS; ++c) {
+        dst[c] = convert_type<float, T>(c < 3 ? clamp(color[c] + offset, 0.0f, 1.0f) : 1.0f);
+    }
+}
 
-    ap.intro("texttool -- a utility for creating text in images\n");
-    ap.usage("texttool [options] ...")
-      .add_help(false)
-      .exit_on_error(true);
+// returns count colors evenly spaced from t 0 to 1 converted once to the
+// native pixel type, channels after rgb are set to 1
+template <typename T>
+static std::vector<T>
+gradient_ramp(const Gradient& gradient, int count, int nchannels)
+{
+    float range = static_cast<float>(std::max(1, count - 1));
+    std::vector<T> ramp(size_t(count) * nchannels);
+    T* color = ramp.data();
+    for (int i = 0; i < count; ++i, color += nchannels) {
+        Imath::Vec3<float> rgb = gradient_color(gradient, static_cast<float>(i) / range);
+        for (int c = 0; c < nchannels; ++c) {
+            color[c] = convert_type<float, T>(c < 3 ? rgb[c] : 1.0f);
+        }
+    }
+    return ramp;
+}
+
+// generates gradient pixels row by row in the native pixel type, the channel
+// count is a compile time constant so inner loops are fixed size stores.
+// vertical and horizontal gradients are evaluated exactly once per row or
+// column of fillroi, other modes look up a ramp with one entry per pixel
+// along the gradient. integer types are dithered to dither bits in the same
+// pass, rows and columns then hold one entry per position of the 8 pixel
+// dither pattern.
+template <typename T, int NCHANNELS>
+class GradientKernel
+{
+public:
+    GradientKernel(const Gradient& gradient, ROI roi, ROI fillroi, int dither)
+    : m_mode(gradient.mode), m_roi(roi), m_fillroi(fillroi), m_step(0.0f)
+    , m_cx(0.0f), m_cy(0.0f), m_dx(0.0f), m_dy(0.0f), m_length(1.0f), m_scale(0.0f)
+    {
+        if (std::is_integral<T>::value && dither > 0) {
+            m_step = 1.0f / ((1 << dither) - 1);
+        }
+        if (m_mode == Gradient::Vertical || m_mode == Gradient::Horizontal) {
+            bool vertical = m_mode == Gradient::Vertical;
+            int begin = vertical ? fillroi.ybegin - roi.ybegin : fillroi.xbegin - roi.xbegin;
+            int count = vertical ? fillroi.height() : fillroi.width();
+            int patterns = dithered() ? 8 : 1;
+            float range = static_cast<float>(std::max(1, (vertical ? roi.height() : roi.width()) - 1));
+            m_ramp.resize(size_t(count) * patterns * NCHANNELS);
+            for (int i = 0; i < count; ++i) {
+                Imath::Vec3<float> rgb = gradient_color(gradient, static_cast<float>(begin + i) / range);
+                for (int p = 0; p < patterns; ++p) {
+                    size_t index = vertical ? size_t(i) * patterns + p : size_t(p) * count + i;
+                    float offset = 0.0f;
+                    if (dithered()) {
+                        int position = (vertical ? fillroi.ybegin : fillroi.xbegin) + i;
+                        offset = (vertical ? dither_offset(p, position) : dither_offset(position, p)) * m_step;
+                    }
+                    gradient_pixel<T, NCHANNELS>(m_ramp.data() + index * NCHANNELS, &rgb[0], offset);
+                }
+            }
+            return;
+        }
+        float width = static_cast<float>(std::max(1, roi.width() - 1));
+        float height = static_cast<float>(std::max(1, roi.height() - 1));
+        m_cx = 0.5f * width;
+        m_cy = 0.5f * height;
+        if (m_mode == Gradient::Radial) {
+            m_length = std::sqrt(m_cx * m_cx + m_cy * m_cy);
+        } else {
+            if (m_mode == Gradient::Diagonal) {
+                float diagonal = std::sqrt(width * width + height * height);
+                m_dx = width / diagonal;
+                m_dy = height / diagonal;
+            } else {
+                float radians = gradient.angle * static_cast<float>(M_PI) / 180.0f;
+                m_dx = std::sin(radians);
+                m_dy = -std::cos(radians);
+            }
+            m_length = std::max(1.0f, std::abs(width * m_dx) + std::abs(height * m_dy));
+        }
+        int count = static_cast<int>(std::ceil(std::sqrt(float(roi.width()) * roi.width() + float(roi.height()) * roi.height())));
+        count = std::min(std::max(2, count + 1), 65536);
+        m_scale = static_cast<float>(count - 1);
+        if (dithered()) {
+            m_floatramp = gradient_ramp<float>(gradient, count, NCHANNELS);
+        } else {
+            m_ramp = gradient_ramp<T>(gradient, count, NCHANNELS);
+        }
+    }
     
-    ap.separator("General flags:");
-    ap.arg("--help", &tool.help)
-      .help("Print help message");
+    // writes pixels xbegin to xend of row y, both within fillroi, to dst
+    void row(T* dst, int xbegin, int xend, int y) const {
+        switch (m_mode) {
+            case Gradient::Vertical: vertical_row(dst, xbegin, xend, y); break;
+            case Gradient::Horizontal: horizontal_row(dst, xbegin, xend, y); break;
+            default: pixels_row(dst, xbegin, xend, y); break;
+        }
+    }
+
+private:
+    bool dithered() const { return m_step > 0.0f; }
+    
+    // broadcasts the row color, or repeats the 8 pixel dither pattern
+    void vertical_row(T* dst, int xbegin, int xend, int y) const {
+        if (dithered()) {
+            const T* pattern = m_ramp.data() + size_t(y - m_fillroi.ybegin) * 8 * NCHANNELS;
+            for (int x = xbegin; x < xend; ++x, dst += NCHANNELS) {
+                const T* color = pattern + (x & 7) * NCHANNELS;
+                for (int c = 0; c < NCHANNELS; ++c) {
+                    dst[c] = color[c];
+                }
+            }
+            return;
+        }
+        const T* color = m_ramp.data() + size_t(y - m_fillroi.ybegin) * NCHANNELS;
+        if (std::is_same<T, float>::value && NCHANNELS == 4) {
+            // float rgba uses simd stores
+            simd::vfloat4 rgba(reinterpret_cast<const float*>(color));
+            float* pixels = reinterpret_cast<float*>(dst);
+            for (int x = xbegin; x < xend; ++x, pixels += 4) {
+                rgba.store(pixels);
+            }
+            return;
+        }
+        for (int x = xbegin; x < xend; ++x, dst += NCHANNELS) {
+            for (int c = 0; c < NCHANNELS; ++c) {
+                dst[c] = color[c];
+            }
+        }
+    }
+    
+    // copies the precomputed column colors of the dither pattern row
+    void horizontal_row(T* dst, int xbegin, int xend, int y) const {
+        size_t pattern = dithered() ? size_t(y & 7) * m_fillroi.width() : 0;
+        const T* row = m_ramp.data() + (pattern + xbegin - m_fillroi.xbegin) * NCHANNELS;
+        std::copy(row, row + size_t(std::max(0, xend - xbegin)) * NCHANNELS, dst);
+    }
+    
+    // evaluates t for four pixels at a time and looks up their colors in the
+    // ramp, t is linear along a direction or the distance from a center
+    void pixels_row(T* dst, int xbegin, int xend, int y) const {
+        simd::vfloat4 zero(0.0f);
+        simd::vfloat4 one(1.0f);
+        float py = static_cast<float>(y - m_roi.ybegin) - m_cy;
+        for (int x = xbegin; x < xend; x += 4) {
+            simd::vfloat4 px = simd::vfloat4::Iota(static_cast<float>(x - m_roi.xbegin) - m_cx);
+            simd::vfloat4 t;
+            if (m_mode == Gradient::Radial) {
+                t = simd::sqrt(px * px + simd::vfloat4(py * py)) / simd::vfloat4(m_length);
+            } else {
+                t = simd::vfloat4(0.5f + py * m_dy / m_length) + px * simd::vfloat4(m_dx / m_length);
+            }
+            simd::vfloat4 index = simd::clamp(t, zero, one) * simd::vfloat4(m_scale) + simd::vfloat4(0.5f);
+            int lanes = std::min(4, xend - x);
+            if (dithered()) {
+                for (int i = 0; i < lanes; ++i, dst += NCHANNELS) {
+                    const float* color = m_floatramp.data() + size_t(index[i]) * NCHANNELS;
+                    gradient_pixel<T, NCHANNELS>(dst, color, dither_offset(x + i, y) * m_step);
+                }
+                continue;
+            }
+            for (int i = 0; i < lanes; ++i, dst += NCHANNELS) {
+                const T* color = m_ramp.data() + size_t(index[i]) * NCHANNELS;
+                for (int c = 0; c < NCHANNELS; ++c) {
+                    dst[c] = color[c];
+                }
+            }
+        }
+    }
+    
+    Gradient::Mode m_mode;
+    ROI m_roi;
+    ROI m_fillroi;
+    float m_step;
+    float m_cx;
+    float m_cy;
+    float m_dx;
+    float m_dy;
+    float m_length;
+    float m_scale;
+    std::vector<T> m_ramp;
+    std::vector<float> m_floatramp;
+};
+
+// fills fillroi with gradient in parallel bands
+template <typename T, int NCHANNELS>
+static void
+gradient_fill(ImageBuf& imagebuf, ROI fillroi, ROI roi, const Gradient& gradient, int dither, int nthreads)
+{
+    GradientKernel<T, NCHANNELS> kernel(gradient, roi, fillroi, dither);
+    ImageBufAlgo::parallel_image(fillroi, nthreads, [&](ROI band) {
+        for (int y = band.ybegin; y < band.yend; ++y) {
+            kernel.row(static_cast<T*>(imagebuf.pixeladdr(band.xbegin, y)), band.xbegin, band.xend, y);
+        }
+    });
+}
+
+// draws gradient over roi in the buffer's native pixel type, specialized for
+// 1 to 4 channels. integer types are ordered dithered to dither bits of
+// output precision, 0 for none. rows are split into bands and filled in
+// parallel using nthreads, 0 uses the global oiio thread count as in
+// imagebufalgo.
+void draw_gradient(ImageBuf &imagebuf, ROI roi, const Gradient& gradient, int dither = 0, int nthreads = 0) {
+    ROI fillroi = roi_intersection(roi, imagebuf.roi());
+    if (fillroi.width() <= 0 || fillroi.height() <= 0 || gradient.stops.empty()) {
+        return;
+    }
+    int nchannels = imagebuf.nchannels();
+    if (nchannels >= 1 && nchannels <= 4 && dispatch_pixels(imagebuf, [&](auto type) {
+            using T = typename std::remove_pointer<decltype(type)>::type;
+            switch (nchannels) {
+                case 1: gradient_fill<T, 1>(imagebuf, fillroi, roi, gradient, dither, nthreads); break;
+                case 2: gradient_fill<T, 2>(imagebuf, fillroi, roi, gradient, dither, nthreads); break;
+                case 3: gradient_fill<T, 3>(imagebuf, fillroi, roi, gradient, dither, nthreads); break;
+                default: gradient_fill<T, 4>(imagebuf, fillroi, roi, gradient, dither, nthreads); break;
+            }
+        })) {
+        return;
+    }
+    // other formats and channel counts render in float and are pasted
+    ImageSpec spec(fillroi.width(), fillroi.height(), std::min(nchannels, 4), TypeFloat);
+    spec.x = fillroi.xbegin;
+    spec.y = fillroi.ybegin;
+    ImageBuf floatbuf(spec);
+    draw_gradient(floatbuf, roi, gradient, 0, nthreads);
+    ImageBufAlgo::paste(imagebuf, fillroi.xbegin, fillroi.ybegin, 0, 0, floatbuf, ROI(), nthreads);
+}
+
+// draws a vertical two color gradient over roi
+void draw_gradient(ImageBuf &imagebuf, ROI roi,  Imath::Vec3<float> startcolor,  Imath::Vec3<float> endcolor, int nthreads = 0) {
+    Gradient gradient;
+    gradient.stops.resize(2);
+    gradient.stops[0].color = startcolor;
+    gradient.stops[1].position = 1.0f;
+    gradient.stops[1].color = endcolor;
+    draw_gradient(imagebuf, roi, gradient, 0, nthreads);
+}
+
+// utils - hash
+
+// fnv-1a 64-bit hash, used for content addressing
+class Hasher
+{
+public:
+    Hasher() : m_hash(14695981039346656037ull) {}
+    
+    Hasher& add(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            m_hash ^= bytes[i];
+            m_hash *= 1099511628211ull;
+        }
+        return *this;
+    }
+    
+    // strings are length prefixed so that field boundaries are part of the hash
+    Hasher& add(const std::string& str) {
+        uint64_t size = str.size();
+        add(&size, sizeof(size));
+        return add(str.data(), str.size());
+    }
+    
+    template <typename T>
+    Hasher& add_value(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+        return add(&value, sizeof(value));
+    }
+    
+    uint64_t value() const { return m_hash; }
+    
+    std::string hex() const {
+        std::ostringstream oss;
+        oss << std::hex << std::setw(16) << std::setfill('0') << m_hash;
+        return oss.str();
+    }
+
+private:
+    uint64_t m_hash;
+};
+
+// utils - fonts
+class FontFile
+{
+public:
+    FontFile() : m_data(nullptr), m_size(0), m_mapped(false), m_hash(0), m_hashed(false) {}
+    
+    ~FontFile() {
+#ifndef _WIN32
+        if (m_mapped) {
+            munmap(const_cast<unsigned char*>(m_data), m_size);
+        }
+#endif
+    }
+    
+    // memory maps the font file, falls back to reading it into memory
+    bool open(const std::string& filename) {
+#ifndef _WIN32
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED) {
+                    m_data = static_cast<const unsigned char*>(data);
+                    m_size = st.st_size;
+                    m_mapped = true;
+                }
+            }
+            ::close(fd);
+            if (m_mapped) {
+                return true;
+            }
+        }
+#endif
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        m_data = reinterpret_cast<const unsigned char*>(m_buffer.data());
+        m_size = m_buffer.size();
+        return m_size > 0;
+    }
+    
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    
+    uint64_t hash() {
+        if (!m_hashed) {
+            m_hash = Hasher().add(m_data, m_size).value();
+            m_hashed = true;
+        }
+        return m_hash;
+    }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    uint64_t m_hash;
+    bool m_hashed;
+    std::vector<char> m_buffer;
+};
+
+struct FontFace
+{
+    FT_Face face = nullptr;
+    int size = 0;
+    uint64_t id = 0; // unique for the registry lifetime, faces may be evicted and their address reused
+    std::mutex mutex; // freetype faces are not thread safe
+};
+
+class FontRegistry
+{
+public:
+    static FontRegistry& instance() {
+        static FontRegistry registry;
+        return registry;
+    }
+    
+    ~FontRegistry() {
+        m_index.clear();
+        m_faces.clear();
+        if (m_library) {
+            FT_Done_FreeType(m_library);
+        }
+    }
+    
+    // returns the face for font file and pixel size, each file is opened
+    // once and each size gets its own face. least recently used faces are
+    // released past the capacity, once no caller holds them anymore
+    std::shared_ptr<FontFace> face(const std::string& filename, int size) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        FaceKey key(filename, size);
+        std::map<FaceKey, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_faces.splice(m_faces.begin(), m_faces, it->second);
+            return it->second->face;
+        }
+        if (!m_library && FT_Init_FreeType(&m_library)) {
+            print_error("could not initialize freetype");
+            return nullptr;
+        }
+        FontFile* file = file_locked(filename);
+        if (!file) {
+            return nullptr;
+        }
+        std::shared_ptr<FontFace> face(new FontFace(), [this](FontFace* face) { release(face); });
+        face->size = size;
+        face->id = ++m_ids;
+        {
+            std::lock_guard<std::mutex> lock(m_library_mutex);
+            if (FT_New_Memory_Face(m_library, file->data(), static_cast<FT_Long>(file->size()), 0, &face->face)) {
+                print_error("could not load font face: ", filename);
+                return nullptr;
+            }
+            if (FT_Set_Pixel_Sizes(face->face, 0, size)) {
+                print_error("could not set font size: ", size);
+                return nullptr;
+            }
+        }
+        Entry entry;
+        entry.key = key;
+        entry.face = face;
+        m_faces.push_front(entry);
+        m_index[key] = m_faces.begin();
+        while (m_faces.size() > m_capacity) {
+            m_index.erase(m_faces.back().key);
+            m_faces.pop_back();
+        }
+        return face;
+    }
+    
+    // returns the content hash of font file, 0 if it can not be opened
+    uint64_t hash(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        FontFile* file = file_locked(filename);
+        return file ? file->hash() : 0;
+    }
+
+private:
+    FontFile* file_locked(const std::string& filename) {
+        std::unique_ptr<FontFile>& file = m_files[filename];
+        if (!file) {
+            file.reset(new FontFile());
+            if (!file->open(filename)) {
+                file.reset();
+                print_error("could not open font file: ", filename);
+                return nullptr;
+            }
+        }
+        return file.get();
+    }
+    
+    // faces are created and done under the library mutex, freetype does not
+    // allow either concurrently on the same library
+    void release(FontFace* face) {
+        if (face->face) {
+            std::lock_guard<std::mutex> lock(m_library_mutex);
+            FT_Done_Face(face->face);
+        }
+        delete face;
+    }
+    
+    typedef std::pair<std::string, int> FaceKey;
+    
+    struct Entry
+    {
+        FaceKey key;
+        std::shared_ptr<FontFace> face;
+    };
+    
+    FontRegistry() : m_library(nullptr), m_capacity(64), m_ids(0) {}
+    
+    FT_Library m_library;
+    std::mutex m_mutex;
+    std::mutex m_library_mutex;
+    std::map<std::string, std::unique_ptr<FontFile>> m_files;
+    std::list<Entry> m_faces;
+    std::map<FaceKey, std::list<Entry>::iterator> m_index;
+    size_t m_capacity;
+    uint64_t m_ids;
+};
+
+// utils - glyphs
+struct GlyphBitmap
+{
+    int left = 0;
+    int top = 0;
+    int width = 0;
+    int height = 0;
+    FT_Pos advance = 0; // 26.6
+    std::vector<unsigned char> coverage;
+};
+
+class GlyphCache
+{
+public:
+    static GlyphCache& instance() {
+        static GlyphCache cache;
+        return cache;
+    }
+    
+    void set_budget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_budget = bytes;
+        evict();
+    }
+    
+    // returns the cached bitmap for glyph at a quarter pixel offset,
+    // rasterizes on miss. font mutex must be held by the caller.
+    std::shared_ptr<const GlyphBitmap> glyph(FontFace& font, FT_UInt glyph, int subpixel) {
+        Key key(font.id, glyph, subpixel);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::map<Key, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+            if (it != m_index.end()) {
+                m_entries.splice(m_entries.begin(), m_entries, it->second);
+                m_hits++;
+                return it->second->bitmap;
+            }
+        }
+        std::shared_ptr<const GlyphBitmap> bitmap = rasterize(font, glyph, subpixel);
+        if (!bitmap) {
+            return bitmap;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_misses++;
+        if (m_index.find(key) == m_index.end()) {
+            Entry entry;
+            entry.key = key;
+            entry.bitmap = bitmap;
+            m_entries.push_front(entry);
+            m_index[key] = m_entries.begin();
+            m_bytes += bytes(*bitmap);
+            evict();
+        }
+        return bitmap;
+    }
+    
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+    size_t memory() const { return m_bytes; }
+    
+    float hitrate() const {
+        size_t lookups = m_hits + m_misses;
+        return lookups ? static_cast<float>(m_hits) / lookups : 0.0f;
+    }
+
+private:
+    struct Key
+    {
+        uint64_t font;
+        FT_UInt glyph;
+        int subpixel;
+        
+        Key(uint64_t font, FT_UInt glyph, int subpixel)
+        : font(font), glyph(glyph), subpixel(subpixel) {}
+        
+        bool operator<(const Key& other) const {
+            if (font != other.font) return font < other.font;
+            if (glyph != other.glyph) return glyph < other.glyph;
+            return subpixel < other.subpixel;
+        }
+    };
+    
+    struct Entry
+    {
+        Key key = Key(0, 0, 0);
+        std::shared_ptr<const GlyphBitmap> bitmap;
+    };
+    
+    GlyphCache() : m_bytes(0), m_budget(64 * 1024 * 1024), m_hits(0), m_misses(0) {}
+    
+    static size_t bytes(const GlyphBitmap& bitmap) {
+        return sizeof(GlyphBitmap) + bitmap.coverage.size();
+    }
+    
+    // least recently used entries are dropped first, bitmaps still in use
+    // are kept alive by their shared pointers
+    void evict() {
+        while (m_bytes > m_budget && !m_entries.empty()) {
+            Entry& entry = m_entries.back();
+            m_bytes -= bytes(*entry.bitmap);
+            m_index.erase(entry.key);
+            m_entries.pop_back();
+        }
+    }
+    
+    static std::shared_ptr<const GlyphBitmap> rasterize(FontFace& font, FT_UInt glyph, int subpixel) {
+        FT_Face face = font.face;
+        if (FT_Load_Glyph(face, glyph, FT_LOAD_TARGET_LIGHT)) {
+            return nullptr;
+        }
+        FT_GlyphSlot slot = face->glyph;
+        if (slot->format == FT_GLYPH_FORMAT_OUTLINE) {
+            FT_Outline_Translate(&slot->outline, subpixel * 16, 0);
+        }
+        if (FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL)) {
+            return nullptr;
+        }
+        std::shared_ptr<GlyphBitmap> bitmap(new GlyphBitmap());
+        const FT_Bitmap& source = slot->bitmap;
+        bitmap->left = slot->bitmap_left;
+        bitmap->top = slot->bitmap_top;
+        bitmap->advance = slot->linearHoriAdvance >> 10;
+        if (source.pixel_mode == FT_PIXEL_MODE_GRAY) {
+            bitmap->width = static_cast<int>(source.width);
+            bitmap->height = static_cast<int>(source.rows);
+            bitmap->coverage.resize(size_t(bitmap->width) * bitmap->height);
+            for (int y = 0; y < bitmap->height; ++y) {
+                std::memcpy(&bitmap->coverage[size_t(y) * bitmap->width], source.buffer + y * source.pitch, bitmap->width);
+            }
+        }
+        return bitmap;
+    }
+    
+    std::mutex m_mutex;
+    std::list<Entry> m_entries;
+    std::map<Key, std::list<Entry>::iterator> m_index;
+    size_t m_bytes;
+    size_t m_budget;
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+};
+
+// utils - text
+
+// a string shaped once: cached glyph bitmaps with their top left pixel
+// positions relative to the baseline origin and the exact pixel bounds they
+// cover, handed as is to the rasterizer
+struct TextLayout
+{
+    struct Glyph
+    {
+        std::shared_ptr<const GlyphBitmap> bitmap;
+        int x = 0;
+        int y = 0;
+    };
+    std::vector<Glyph> glyphs;
+    ROI bounds = ROI(0, 0, 0, 0);
+};
+
+// shapes text from the baseline origin with quarter pixel positioning
+static TextLayout
+shape_text(const std::string& text, FontFace& font)
+{
+    std::vector<uint32_t> chars;
+    Strutil::utf8_to_unicode(text, chars);
+    TextLayout layout;
+    std::lock_guard<std::mutex> lock(font.mutex);
+    FT_Face face = font.face;
+    FT_Pos lineheight = face->size->metrics.height;
+    FT_Pos penx = 0, peny = 0;
+    FT_UInt previous = 0;
+    ROI bounds;
+    for (uint32_t c : chars) {
+        if (c == '\n') {
+            penx = 0;
+            peny += lineheight;
+            previous = 0;
+            continue;
+        }
+        FT_UInt glyph = FT_Get_Char_Index(face, c);
+        if (previous && glyph && FT_HAS_KERNING(face)) {
+            FT_Vector kerning;
+            FT_Get_Kerning(face, previous, glyph, FT_KERNING_UNFITTED, &kerning);
+            penx += kerning.x;
+        }
+        previous = glyph;
+        int subpixel = static_cast<int>((penx & 63) >> 4);
+        std::shared_ptr<const GlyphBitmap> bitmap = GlyphCache::instance().glyph(font, glyph, subpixel);
+        if (!bitmap) {
+            continue;
+        }
+        if (bitmap->width && bitmap->height) {
+            TextLayout::Glyph placed;
+            placed.bitmap = bitmap;
+            placed.x = static_cast<int>(penx >> 6) + bitmap->left;
+            placed.y = static_cast<int>(peny >> 6) - bitmap->top;
+            bounds = roi_union(bounds, ROI(placed.x, placed.x + bitmap->width, placed.y, placed.y + bitmap->height));
+            layout.glyphs.push_back(placed);
+        }
+        penx += bitmap->advance;
+    }
+    if (bounds.defined()) {
+        layout.bounds = bounds;
+    }
+    return layout;
+}
+
+// moves the origin x, y so that textsize is aligned at x, y
+static void
+align_text(const ROI& textsize, ImageBufAlgo::TextAlignX alignx, ImageBufAlgo::TextAlignY aligny, int& x, int& y)
+{
+    switch (alignx) {
+        case ImageBufAlgo::TextAlignX::Right: x -= textsize.xend; break;
+        case ImageBufAlgo::TextAlignX::Center: x -= textsize.xbegin + textsize.width() / 2; break;
+        default: break;
+    }
+    switch (aligny) {
+        case ImageBufAlgo::TextAlignY::Top: y -= textsize.ybegin; break;
+        case ImageBufAlgo::TextAlignY::Bottom: y -= textsize.yend; break;
+        case ImageBufAlgo::TextAlignY::Center: y -= textsize.ybegin + textsize.height() / 2; break;
+        default: break;
+    }
+}
+
+// returns the pixel rect covered by text aligned at x, y
+static ROI
+text_roi(const TextLayout& text, int x, int y, ImageBufAlgo::TextAlignX alignx, ImageBufAlgo::TextAlignY aligny)
+{
+    align_text(text.bounds, alignx, aligny, x, y);
+    return ROI(text.bounds.xbegin + x, text.bounds.xend + x, text.bounds.ybegin + y, text.bounds.yend + y);
+}
+
+// text coverage rasterized once per card and composited in color during the
+// background sweep, stored as roi.width() bytes per row
+struct TextMask
+{
+    ROI roi;
+    Imath::Vec3<float> color;
+    std::vector<unsigned char> coverage;
+    
+    void reset(ROI maskroi, Imath::Vec3<float> maskcolor) {
+        roi = maskroi;
+        color = maskcolor;
+        coverage.assign(std::max(imagesize_t(0), maskroi.npixels()), 0);
+    }
+    
+    unsigned char* row(int y) {
+        return coverage.data() + size_t(y - roi.ybegin) * roi.width();
+    }
+    
+    const unsigned char* row(int y) const {
+        return coverage.data() + size_t(y - roi.ybegin) * roi.width();
+    }
+};
+
+// rasterizes shaped text aligned at x, y into mask, overlapping coverage is
+// combined as over
+static void
+rasterize_text(TextMask& mask, int x, int y, const TextLayout& text,
+               ImageBufAlgo::TextAlignX alignx, ImageBufAlgo::TextAlignY aligny)
+{
+    align_text(text.bounds, alignx, aligny, x, y);
+    for (const TextLayout::Glyph& glyph : text.glyphs) {
+        const GlyphBitmap& bitmap = *glyph.bitmap;
+        int gx = glyph.x + x;
+        int gy = glyph.y + y;
+        ROI rect = roi_intersection(ROI(gx, gx + bitmap.width, gy, gy + bitmap.height), mask.roi);
+        for (int ry = rect.ybegin; ry < rect.yend; ++ry) {
+            const unsigned char* src = bitmap.coverage.data() + (ry - gy) * bitmap.width + (rect.xbegin - gx);
+            unsigned char* dst = mask.row(ry) + (rect.xbegin - mask.roi.xbegin);
+            for (int i = 0; i < rect.width(); ++i) {
+                dst[i] = static_cast<unsigned char>(dst[i] + ((255 - dst[i]) * src[i] + 127) / 255);
+            }
+        }
+    }
+}
+
+// utils - composite
+
+// blends coverage over count native pixels stride values apart, opaque holds
+// the text color converted to T and values the same color in float. channels
+// past NCHANNELS are kept
+template <typename T, int NCHANNELS>
+static inline void
+composite_span(T* pixel, const unsigned char* coverage, int count, const T* opaque, const float* values, int stride = NCHANNELS)
+{
+    for (int x = 0; x < count; ++x, pixel += stride) {
+        unsigned char value = coverage[x];
+        if (!value) {
+            continue;
+        }
+        if (value == 255) {
+            std::copy(opaque, opaque + NCHANNELS, pixel);
+            continue;
+        }
+        float alpha = value / 255.0f;
+        for (int c = 0; c < NCHANNELS; ++c) {
+            pixel[c] = convert_type<float, T>(alpha * values[c] + (1.0f - alpha) * convert_type<T, float>(pixel[c]));
+        }
+    }
+}
+
+// returns the opaque text color of each mask as NCHANNELS native and float
+// values, channels after rgb are 1
+template <typename T, int NCHANNELS>
+static void
+mask_colors(const std::vector<const TextMask*>& masks, std::vector<T>& opaque, std::vector<float>& values)
+{
+    opaque.resize(masks.size() * NCHANNELS);
+    values.resize(masks.size() * NCHANNELS);
+    for (size_t m = 0; m < masks.size(); ++m) {
+        for (int c = 0; c < NCHANNELS; ++c) {
+            values[m * NCHANNELS + c] = c < 3 ? masks[m]->color[c] : 1.0f;
+            opaque[m * NCHANNELS + c] = convert_type<float, T>(values[m * NCHANNELS + c]);
+        }
+    }
+}
+
+// fills fillroi with the background and blends the coverage of all masks in
+// the same sweep. spans crossing masks are assembled in a scratch row so that
+// every pixel of imagebuf is written once
+template <typename T, int NCHANNELS>
+static void
+composite_fill(ImageBuf& imagebuf, ROI fillroi, ROI roi, const Gradient& background, int dither,
+               const std::vector<const TextMask*>& masks, int nthreads)
+{
+    GradientKernel<T, NCHANNELS> kernel(background, roi, fillroi, dither);
+    std::vector<T> opaque;
+    std::vector<float> values;
+    mask_colors<T, NCHANNELS>(masks, opaque, values);
+    ImageBufAlgo::parallel_image(fillroi, nthreads, [&](ROI band) {
+        std::vector<T> scratch;
+        for (int y = band.ybegin; y < band.yend; ++y) {
+            T* dst = static_cast<T*>(imagebuf.pixeladdr(band.xbegin, y));
+            int xbegin = band.xend;
+            int xend = band.xbegin;
+            for (const TextMask* mask : masks) {
+                if (y >= mask->roi.ybegin && y < mask->roi.yend) {
+                    xbegin = std::min(xbegin, std::max(band.xbegin, mask->roi.xbegin));
+                    xend = std::max(xend, std::min(band.xend, mask->roi.xend));
+                }
+            }
+            if (xbegin >= xend) {
+                kernel.row(dst, band.xbegin, band.xend, y);
+                continue;
+            }
+            kernel.row(dst, band.xbegin, xbegin, y);
+            kernel.row(dst + size_t(xend - band.xbegin) * NCHANNELS, xend, band.xend, y);
+            scratch.resize(size_t(xend - xbegin) * NCHANNELS);
+            kernel.row(scratch.data(), xbegin, xend, y);
+            for (size_t m = 0; m < masks.size(); ++m) {
+                const TextMask& mask = *masks[m];
+                int spanbegin = std::max(xbegin, mask.roi.xbegin);
+                int spanend = std::min(xend, mask.roi.xend);
+                if (y >= mask.roi.ybegin && y < mask.roi.yend && spanbegin < spanend) {
+                    composite_span<T, NCHANNELS>(scratch.data() + size_t(spanbegin - xbegin) * NCHANNELS,
+                                                 mask.row(y) + (spanbegin - mask.roi.xbegin), spanend - spanbegin,
+                                                 opaque.data() + m * NCHANNELS, values.data() + m * NCHANNELS);
+                }
+            }
+            std::copy(scratch.begin(), scratch.end(), dst + size_t(xbegin - band.xbegin) * NCHANNELS);
+        }
+    });
+}
+
+// draws background over roi and composites mask coverage in a single pass
+// over imagebuf, later masks are composited over earlier ones and null masks
+// are skipped. a defined clip limits the pixels drawn while the background
+// stays relative to roi. specialized for native types with 1 to 4 channels,
+// using nthreads as in draw_gradient
+static void
+draw_composite(ImageBuf& imagebuf, ROI roi, const Gradient& background, int dither,
+               const std::vector<std::shared_ptr<const TextMask>>& textmasks, int nthreads = 0, ROI clip = ROI::All())
+{
+    ROI fillroi = roi_intersection(roi, imagebuf.roi());
+    if (clip.defined()) {
+        fillroi = roi_intersection(fillroi, clip);
+    }
+    if (fillroi.width() <= 0 || fillroi.height() <= 0 || background.stops.empty()) {
+        return;
+    }
+    std::vector<const TextMask*> masks;
+    for (const std::shared_ptr<const TextMask>& mask : textmasks) {
+        if (mask) {
+            masks.push_back(mask.get());
+        }
+    }
+    int nchannels = imagebuf.nchannels();
+    if (nchannels >= 1 && nchannels <= 4 && dispatch_pixels(imagebuf, [&](auto type) {
+            using T = typename std::remove_pointer<decltype(type)>::type;
+            switch (nchannels) {
+                case 1: composite_fill<T, 1>(imagebuf, fillroi, roi, background, dither, masks, nthreads); break;
+                case 2: composite_fill<T, 2>(imagebuf, fillroi, roi, background, dither, masks, nthreads); break;
+                case 3: composite_fill<T, 3>(imagebuf, fillroi, roi, background, dither, masks, nthreads); break;
+                default: composite_fill<T, 4>(imagebuf, fillroi, roi, background, dither, masks, nthreads); break;
+            }
+        })) {
+        return;
+    }
+    // other formats and channel counts render in float and are pasted
+    ImageSpec spec(fillroi.width(), fillroi.height(), std::min(nchannels, 4), TypeFloat);
+    spec.x = fillroi.xbegin;
+    spec.y = fillroi.ybegin;
+    ImageBuf floatbuf(spec);
+    draw_composite(floatbuf, roi, background, 0, textmasks, nthreads);
+    ImageBufAlgo::paste(imagebuf, fillroi.xbegin, fillroi.ybegin, 0, 0, floatbuf, ROI(), nthreads);
+}
+
+// blends the coverage of all masks over the existing pixels of imagebuf within
+// fillroi, rows are split into bands as in draw_gradient
+template <typename T, int NCHANNELS>
+static void
+overlay_fill(ImageBuf& imagebuf, ROI fillroi, const std::vector<const TextMask*>& masks, int nthreads)
+{
+    std::vector<T> opaque;
+    std::vector<float> values;
+    mask_colors<T, NCHANNELS>(masks, opaque, values);
+    int stride = imagebuf.nchannels();
+    ImageBufAlgo::parallel_image(fillroi, nthreads, [&](ROI band) {
+        for (int y = band.ybegin; y < band.yend; ++y) {
+            for (size_t m = 0; m < masks.size(); ++m) {
+                const TextMask& mask = *masks[m];
+                int spanbegin = std::max(band.xbegin, mask.roi.xbegin);
+                int spanend = std::min(band.xend, mask.roi.xend);
+                if (y >= mask.roi.ybegin && y < mask.roi.yend && spanbegin < spanend) {
+                    composite_span<T, NCHANNELS>(static_cast<T*>(imagebuf.pixeladdr(spanbegin, y)),
+                                                 mask.row(y) + (spanbegin - mask.roi.xbegin), spanend - spanbegin,
+                                                 opaque.data() + m * NCHANNELS, values.data() + m * NCHANNELS, stride);
+                }
+            }
+        }
+    });
+}
+
+// composites mask coverage over the existing pixels of imagebuf in place,
+// only rows and columns covered by masks are touched. the first four channels
+// are blended and any further channels kept. returns false if the pixels are
+// not of a native type, using nthreads as in draw_gradient
+static bool
+draw_overlay(ImageBuf& imagebuf, const std::vector<std::shared_ptr<const TextMask>>& textmasks, int nthreads = 0)
+{
+    std::vector<const TextMask*> masks;
+    ROI fillroi(0, 0, 0, 0);
+    for (const std::shared_ptr<const TextMask>& mask : textmasks) {
+        if (mask) {
+            masks.push_back(mask.get());
+            fillroi = fillroi.npixels() > 0 ? roi_union(fillroi, mask->roi) : mask->roi;
+        }
+    }
+    fillroi = roi_intersection(fillroi, imagebuf.roi());
+    if (fillroi.width() <= 0 || fillroi.height() <= 0) {
+        return true;
+    }
+    int nchannels = imagebuf.nchannels();
+    return nchannels >= 1 && dispatch_pixels(imagebuf, [&](auto type) {
+        using T = typename std::remove_pointer<decltype(type)>::type;
+        switch (std::min(nchannels, 4)) {
+            case 1: overlay_fill<T, 1>(imagebuf, fillroi, masks, nthreads); break;
+            case 2: overlay_fill<T, 2>(imagebuf, fillroi, masks, nthreads); break;
+            case 3: overlay_fill<T, 3>(imagebuf, fillroi, masks, nthreads); break;
+            default: overlay_fill<T, 4>(imagebuf, fillroi, masks, nthreads); break;
+        }
+    });
+}
+
+// utils - json
+struct JsonValue
+{
+    enum Type { Null, Bool, Number, String, Array, Object };
+    Type type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> values; // array elements or object values
+    std::vector<std::string> keys; // object keys, parallel to values
+    
+    const JsonValue* find(const std::string& key) const {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == key) {
+                return &values[i];
+            }
+        }
+        return nullptr;
+    }
+    
+    std::string str() const {
+        switch (type) {
+            case Bool: return boolean ? "true" : "false";
+            case String: return string;
+            case Number: {
+                // whole numbers print as integers, others with the shortest
+                // precision that reads back to the same double
+                if (std::isfinite(number) && number == std::floor(number) && std::fabs(number) < 1e15) {
+                    return std::to_string(static_cast<long long>(number));
+                }
+                std::ostringstream oss;
+                oss << std::setprecision(15) << number;
+                if (std::stod(oss.str()) != number) {
+                    oss.str("");
+                    oss << std::setprecision(17) << number;
+                }
+                return oss.str();
+            }
+            case Array: {
+                std::string str;
+                for (const JsonValue& value : values) {
+                    if (str.size()) {
+                        str += ",";
+                    }
+                    str += value.str();
+                }
+                return str;
+            }
+            default: return std::string();
+        }
+    }
+};
+
+class JsonParser
+{
+public:
+    JsonParser(const std::string& text) : m_text(text), m_pos(0), m_depth(0) {}
+    
+    bool parse(JsonValue& value) {
+        if (!parse_value(value)) {
+            return false;
+        }
+        skip_whitespace();
+        if (m_pos != m_text.size()) {
+            return fail("unexpected trailing characters");
+        }
+        return true;
+    }
+    
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message) {
+        std::ostringstream oss;
+        oss << message << " at offset " << m_pos;
+        m_error = oss.str();
+        return false;
+    }
+    
+    void skip_whitespace() {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) {
+            m_pos++;
+        }
+    }
+    
+    bool consume(char c) {
+        skip_whitespace();
+        if (m_pos < m_text.size() && m_text[m_pos] == c) {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+    
+    bool parse_literal(const char* literal) {
+        size_t length = std::strlen(literal);
+        if (m_text.compare(m_pos, length, literal) != 0) {
+            return fail("invalid literal");
+        }
+        m_pos += length;
+        return true;
+    }
+    
+    static void append_utf8(std::string& str, uint32_t c) {
+        if (c < 0x80) {
+            str += static_cast<char>(c);
+        } else if (c < 0x800) {
+            str += static_cast<char>(0xc0 | (c >> 6));
+            str += static_cast<char>(0x80 | (c & 0x3f));
+        } else if (c < 0x10000) {
+            str += static_cast<char>(0xe0 | (c >> 12));
+            str += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            str += static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            str += static_cast<char>(0xf0 | (c >> 18));
+            str += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            str += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            str += static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+    
+    bool parse_hex(uint32_t& c) {
+        if (m_pos + 4 > m_text.size()) {
+            return fail("truncated unicode escape");
+        }
+        c = 0;
+        for (int i = 0; i < 4; ++i) {
+            char h = m_text[m_pos++];
+            c <<= 4;
+            if (h >= '0' && h <= '9') c |= h - '0';
+            else if (h >= 'a' && h <= 'f') c |= h - 'a' + 10;
+            else if (h >= 'A' && h <= 'F') c |= h - 'A' + 10;
+            else return fail("invalid unicode escape");
+        }
+        return true;
+    }
+    
+    bool parse_string(std::string& str) {
+        if (!consume('"')) {
+            return fail("expected string");
+        }
+        while (m_pos < m_text.size()) {
+            char c = m_text[m_pos++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                str += c;
+                continue;
+            }
+            if (m_pos >= m_text.size()) {
+                break;
+            }
+            char e = m_text[m_pos++];
+            switch (e) {
+                case '"': str += '"'; break;
+                case '\\': str += '\\'; break;
+                case '/': str += '/'; break;
+                case 'b': str += '\b'; break;
+                case 'f': str += '\f'; break;
+                case 'n': str += '\n'; break;
+                case 'r': str += '\r'; break;
+                case 't': str += '\t'; break;
+                case 'u': {
+                    uint32_t c;
+                    if (!parse_hex(c)) {
+                        return false;
+                    }
+                    // surrogate pair, lone surrogates are not valid utf-8
+                    if (c >= 0xd800 && c <= 0xdbff) {
+                        if (m_text.compare(m_pos, 2, "\\u") != 0) {
+                            return fail("invalid surrogate pair");
+                        }
+                        uint32_t low;
+                        m_pos += 2;
+                        if (!parse_hex(low)) {
+                            return false;
+                        }
+                        if (low < 0xdc00 || low > 0xdfff) {
+                            return fail("invalid surrogate pair");
+                        }
+                        c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                    } else if (c >= 0xdc00 && c <= 0xdfff) {
+                        return fail("invalid surrogate pair");
+                    }
+                    append_utf8(str, c);
+                    break;
+                }
+                default: return fail("invalid escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+    
+    bool parse_number(JsonValue& value) {
+        const char* begin = m_text.c_str() + m_pos;
+        char* end = nullptr;
+        value.number = std::strtod(begin, &end);
+        if (end == begin) {
+            return fail("invalid number");
+        }
+        value.type = JsonValue::Number;
+        m_pos += end - begin;
+        return true;
+    }
+    
+    bool parse_value(JsonValue& value) {
+        skip_whitespace();
+        if (m_pos >= m_text.size()) {
+            return fail("unexpected end of input");
+        }
+        char c = m_text[m_pos];
+        if ((c == '{' || c == '[') && ++m_depth > max_depth) {
+            return fail("nesting too deep");
+        }
+        if (c == '{') {
+            m_pos++;
+            value.type = JsonValue::Object;
+            if (consume('}')) {
+                m_depth--;
+                return true;
+            }
+            do {
+                std::string key;
+                skip_whitespace();
+                if (!parse_string(key)) {
+                    return false;
+                }
+                if (!consume(':')) {
+                    return fail("expected ':'");
+                }
+                value.keys.push_back(key);
+                value.values.push_back(JsonValue());
+                if (!parse_value(value.values.back())) {
+                    return false;
+                }
+            } while (consume(','));
+            if (!consume('}')) {
+                return fail("expected '}'");
+            }
+            m_depth--;
+            return true;
+        } else if (c == '[') {
+            m_pos++;
+            value.type = JsonValue::Array;
+            if (consume(']')) {
+                m_depth--;
+                return true;
+            }
+            do {
+                value.values.push_back(JsonValue());
+                if (!parse_value(value.values.back())) {
+                    return false;
+                }
+            } while (consume(','));
+            if (!consume(']')) {
+                return fail("expected ']'");
+            }
+            m_depth--;
+            return true;
+        } else if (c == '"') {
+            value.type = JsonValue::String;
+            return parse_string(value.string);
+        } else if (c == 't') {
+            value.type = JsonValue::Bool;
+            value.boolean = true;
+            return parse_literal("true");
+        } else if (c == 'f') {
+            value.type = JsonValue::Bool;
+            value.boolean = false;
+            return parse_literal("false");
+        } else if (c == 'n') {
+            value.type = JsonValue::Null;
+            return parse_literal("null");
+        }
+        return parse_number(value);
+    }
+    
+    // arrays and objects are parsed recursively, deeper documents are
+    // rejected before they can exhaust the stack
+    static const int max_depth = 64;
+
+    const std::string& m_text;
+    size_t m_pos;
+    int m_depth;
+    std::string m_error;
+};
+
+// escapes str for a json string, control characters without a short escape
+// are written as \u00XX
+static std::string
+json_escape(const std::string& str)
+{
+    std::string escaped;
+    for (char c : str) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    std::ostringstream oss;
+                    oss << "\\u" << std::hex << std::setfill('0') << std::setw(4) << static_cast<int>(static_cast<unsigned char>(c));
+                    escaped += oss.str();
+                } else {
+                    escaped += c;
+                }
+                break;
+        }
+    }
+    return escaped;
+}
+
+// utils - jobs
+class JobPool
+{
+public:
+    typedef std::function<void()> Job;
+    
+    JobPool(int threads)
+    : m_pending(0), m_queued(0), m_next(0), m_stop(false)
+    {
+        for (int i = 0; i < threads; ++i) {
+            m_queues.emplace_back(new Queue());
+        }
+        for (int i = 0; i < threads; ++i) {
+            m_workers.emplace_back(&JobPool::run, this, static_cast<size_t>(i));
+        }
+    }
+    
+    ~JobPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_ready.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+    }
+    
+    int threads() const { return static_cast<int>(m_workers.size()); }
+    
+    // jobs submitted from a worker go to its own queue, others round robin
+    void submit(Job job) {
+        size_t index = worker().pool == this ? worker().index : m_next++ % m_queues.size();
+        m_pending++;
+        {
+            std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+            m_queues[index]->jobs.push_back(std::move(job));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queued++;
+        }
+        m_ready.notify_one();
+    }
+    
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_pending == 0; });
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+    
+    struct Worker
+    {
+        const JobPool* pool = nullptr;
+        size_t index = 0;
+    };
+    
+    static Worker& worker() {
+        static thread_local Worker worker;
+        return worker;
+    }
+    
+    // owner takes the most recent job, thieves take the oldest
+    bool pop(size_t index, Job& job) {
+        Queue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            return false;
+        }
+        job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+        return true;
+    }
+    
+    bool steal(size_t index, Job& job) {
+        for (size_t i = 1; i < m_queues.size(); ++i) {
+            Queue& queue = *m_queues[(index + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty()) {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void run(size_t index) {
+        worker().pool = this;
+        worker().index = index;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_ready.wait(lock, [this] { return m_stop || m_queued > 0; });
+                if (m_stop && m_queued == 0) {
+                    return;
+                }
+            }
+            Job job;
+            if (pop(index, job) || steal(index, job)) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_queued--;
+                }
+                job();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_pending == 0) {
+                    m_done.notify_all();
+                }
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+    
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::condition_variable m_done;
+    std::atomic<int> m_pending;
+    int m_queued;
+    std::atomic<size_t> m_next;
+    bool m_stop;
+};
+
+// utils - manifest
+typedef std::map<std::string, std::string> ManifestRow;
+
+static std::vector<std::string>
+parse_csv_line(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"') {
+                if (i + 1 < line.size() && line[i + 1] == '"') {
+                    field += '"';
+                    i++;
+                } else {
+                    quoted = false;
+                }
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.push_back(field);
+            field.clear();
+        } else if (c != '\r') {
+            field += c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+static bool
+read_manifest_csv(const std::string& text, std::vector<ManifestRow>& rows, std::string& error)
+{
+    std::istringstream iss(text);
+    std::string line;
+    std::vector<std::string> header;
+    int linenumber = 0;
+    while (std::getline(iss, line)) {
+        linenumber++;
+        if (Strutil::trimmed_whitespace(line).empty()) {
+            continue;
+        }
+        std::vector<std::string> fields = parse_csv_line(line);
+        if (!header.size()) {
+            for (const std::string& field : fields) {
+                header.push_back(Strutil::lower(Strutil::trimmed_whitespace(field)));
+            }
+            continue;
+        }
+        if (fields.size() > header.size()) {
+            std::ostringstream oss;
+            oss << "too many fields on line " << linenumber;
+            error = oss.str();
+            return false;
+        }
+        ManifestRow row;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            row[header[i]] = fields[i];
+        }
+        rows.push_back(row);
+    }
+    return true;
+}
+
+static ManifestRow
+row_from_json(const JsonValue& object)
+{
+    ManifestRow row;
+    for (size_t i = 0; i < object.keys.size(); ++i) {
+        row[Strutil::lower(object.keys[i])] = object.values[i].str();
+    }
+    return row;
+}
+
+static bool
+read_manifest_json(const std::string& text, std::vector<ManifestRow>& rows, std::string& error)
+{
+    JsonValue document;
+    JsonParser parser(text);
+    if (!parser.parse(document)) {
+        error = parser.error();
+        return false;
+    }
+    const JsonValue* cards = &document;
+    if (document.type == JsonValue::Object) {
+        cards = document.find("cards");
+    }
+    if (!cards || cards->type != JsonValue::Array) {
+        error = "expected an array of cards";
+        return false;
+    }
+    for (const JsonValue& card : cards->values) {
+        if (card.type != JsonValue::Object) {
+            error = "expected card to be an object";
+            return false;
+        }
+        rows.push_back(row_from_json(card));
+    }
+    return true;
+}
+
+static bool
+card_from_row(const ManifestRow& row, TextCard& card, std::string& error)
+{
+    card.title = tool.title;
+    card.subtitle = tool.subtitle;
+    card.gradient = tool.gradient;
+    card.outputfile = tool.outputfile;
+    card.inputfile = tool.inputfile;
+    card.size = tool.size;
+    card.fields = tool.fields;
+    for (const std::pair<const std::string, std::string>& pair : row) {
+        const std::string& key = pair.first;
+        const std::string& value = pair.second;
+        card.fields[key] = value;
+        if (key == "title") {
+            card.title = value;
+        } else if (key == "subtitle") {
+            card.subtitle = value;
+        } else if (key == "gradient") {
+            card.gradient = value;
+        } else if (key == "outputfile" || key == "output") {
+            card.outputfile = value;
+        } else if (key == "inputfile" || key == "input") {
+            card.inputfile = value;
+        } else if (key == "size") {
+            if (value.size() && !parse_size(value, card.size)) {
+                error = "could not parse size from string: " + value;
+                return false;
+            }
+        } else if (key == "width") {
+            card.size.x = Strutil::stoi(value);
+        } else if (key == "height") {
+            card.size.y = Strutil::stoi(value);
+        }
+    }
+    if (!card.outputfile.size()) {
+        error = "card is missing output file";
+        return false;
+    }
+    if (card.size.x <= 0 || card.size.y <= 0) {
+        error = "card has invalid size";
+        return false;
+    }
+    return true;
+}
+
+static bool
+read_manifest(const std::string& filename, std::vector<TextCard>& cards)
+{
+    std::string text;
+    if (!Filesystem::read_text_file(filename, text)) {
+        print_error("could not read batch file: ", filename);
+        return false;
+    }
+    std::vector<ManifestRow> rows;
+    std::string error;
+    bool json = Strutil::iequals(Filesystem::extension(filename), ".json");
+    if (!(json ? read_manifest_json(text, rows, error) : read_manifest_csv(text, rows, error))) {
+        print_error("could not parse batch file: ", error);
+        return false;
+    }
+    for (size_t i = 0; i < rows.size(); ++i) {
+        TextCard card;
+        if (!card_from_row(rows[i], card, error)) {
+            std::ostringstream oss;
+            oss << "card " << i + 1 << " in batch file: " << error;
+            print_error(oss.str());
+            return false;
+        }
+        cards.push_back(card);
+    }
+    return true;
+}
+
+// utils - hues
+static const std::map<std::string, float>&
+gradient_hues()
+{
+    static std::map<std::string, float> hues = {
+        { "red", 360.0f },
+        { "orange", 30.0f },
+        { "yellow", 60.0f },
+        { "green", 120.0f },
+        { "cyan", 180.0f },
+        { "azure", 210.0f },
+        { "blue", 240.0f },
+        { "violet", 270.0f },
+        { "magenta", 300.0f },
+        { "rose", 330.0f }
+    };
+    return hues;
+}
+
+// parses a color from #rrggbb or a hue name
+static bool
+parse_color(const std::string& value, Imath::Vec3<float>& color)
+{
+    std::string str = Strutil::lower(Strutil::trimmed_whitespace(value));
+    const std::map<std::string, float>& hues = gradient_hues();
+    std::map<std::string, float>::const_iterator it = hues.find(str);
+    if (it != hues.end()) {
+        color = rgb_from_hsv(Imath::Vec3<float>(it->second, 1.0, 0.5));
+        return true;
+    }
+    if (str.size() == 7 && str[0] == '#' && str.find_first_not_of("0123456789abcdef", 1) == std::string::npos) {
+        for (int c = 0; c < 3; ++c) {
+            color[c] = std::stoi(str.substr(1 + c * 2, 2), nullptr, 16) / 255.0f;
+        }
+        return true;
+    }
+    return false;
+}
+
+// parses a gradient from a hue name or [mode:]color[@position],... where mode
+// is vertical, horizontal, diagonal, radial or an angle in degrees and color
+// is #rrggbb or a hue name. stops without positions are evenly spaced.
+static bool
+parse_gradient(const std::string& spec, Gradient& gradient)
+{
+    const std::map<std::string, float>& hues = gradient_hues();
+    std::string stops = spec;
+    size_t colon = spec.find(':');
+    if (colon != std::string::npos) {
+        std::string mode = Strutil::lower(spec.substr(0, colon));
+        stops = spec.substr(colon + 1);
+        if (mode == "vertical") {
+            gradient.mode = Gradient::Vertical;
+        } else if (mode == "horizontal") {
+            gradient.mode = Gradient::Horizontal;
+        } else if (mode == "diagonal") {
+            gradient.mode = Gradient::Diagonal;
+        } else if (mode == "radial") {
+            gradient.mode = Gradient::Radial;
+        } else if (Strutil::string_is_float(mode)) {
+            gradient.mode = Gradient::Linear;
+            gradient.angle = Strutil::stof(mode);
+        } else {
+            return false;
+        }
+    }
+    // a single hue is the two color gradient from the hue map
+    std::map<std::string, float>::const_iterator it = hues.find(Strutil::lower(stops));
+    if (it != hues.end()) {
+        gradient.stops.resize(2);
+        gradient.stops[0].color = rgb_from_hsv(Imath::Vec3<float>(it->second, 1.0, 0.5));
+        gradient.stops[1].position = 1.0f;
+        gradient.stops[1].color = rgb_from_hsv(Imath::Vec3<float>(it->second, 0.5, 0.8));
+        return true;
+    }
+    std::vector<std::string> values = Strutil::splits(stops, ",");
+    if (values.size() < 2) {
+        return false;
+    }
+    gradient.stops.clear();
+    for (size_t i = 0; i < values.size(); ++i) {
+        std::vector<std::string> parts = Strutil::splits(values[i], "@");
+        GradientStop stop;
+        stop.position = static_cast<float>(i) / (values.size() - 1);
+        if (parts.size() == 2) {
+            std::string position = Strutil::trimmed_whitespace(parts[1]);
+            if (!Strutil::string_is_float(position)) {
+                return false;
+            }
+            stop.position = Strutil::stof(position);
+        } else if (parts.size() != 1) {
+            return false;
+        }
+        if (!parse_color(parts[0], stop.color)) {
+            return false;
+        }
+        if (gradient.stops.size() && stop.position < gradient.stops.back().position) {
+            return false;
+        }
+        gradient.stops.push_back(stop);
+    }
+    return true;
+}
+
+// utils - template
+
+// one text block of a layout template. size is the font size relative to the
+// card height, x and y the anchor the aligned text is placed at relative to
+// the card size
+struct TemplateBlock
+{
+    struct Segment
+    {
+        std::string text; // literal text or lowercase field name
+        bool field = false;
+    };
+    std::vector<Segment> segments;
+    std::string fontfile;
+    float size = 0.1f;
+    float x = 0.5f;
+    float y = 0.5f;
+    ImageBufAlgo::TextAlignX alignx = ImageBufAlgo::TextAlignX::Left;
+    ImageBufAlgo::TextAlignY aligny = ImageBufAlgo::TextAlignY::Top;
+    Imath::Vec3<float> color;
+    bool constant = false; // text is the same for every card in the run
+    
+    // returns the block text with {field} references substituted from card
+    std::string text(const TextCard& card) const {
+        std::string text;
+        for (const Segment& segment : segments) {
+            if (!segment.field) {
+                text += segment.text;
+            } else if (segment.text == "title") {
+                text += card.title;
+            } else if (segment.text == "subtitle") {
+                text += card.subtitle;
+            } else {
+                std::map<std::string, std::string>::const_iterator it = card.fields.find(segment.text);
+                if (it != card.fields.end()) {
+                    text += it->second;
+                }
+            }
+        }
+        return text;
+    }
+};
+
+// a layout template compiled once per run and shared by all cards, per card
+// work is field substitution, shaping and rasterization
+struct TemplatePlan
+{
+    std::vector<TemplateBlock> blocks;
+    uint64_t hash = 0; // template source and fonts, part of the output cache key
+};
+
+// splits text into literal and {field} segments
+static std::vector<TemplateBlock::Segment>
+template_segments(const std::string& text)
+{
+    std::vector<TemplateBlock::Segment> segments;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t begin = text.find('{', pos);
+        size_t end = begin == std::string::npos ? begin : text.find('}', begin);
+        TemplateBlock::Segment literal;
+        literal.text = text.substr(pos, end == std::string::npos ? std::string::npos : begin - pos);
+        if (literal.text.size()) {
+            segments.push_back(literal);
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        TemplateBlock::Segment field;
+        field.text = Strutil::lower(Strutil::trimmed_whitespace(text.substr(begin + 1, end - begin - 1)));
+        field.field = true;
+        segments.push_back(field);
+        pos = end + 1;
+    }
+    return segments;
+}
+
+// resolves a template font, absolute paths are used as given and relative
+// paths are looked up next to the template before the bundled fonts
+static std::string
+template_font(const std::string& font, const std::string& directory)
+{
+    if (Filesystem::path_is_absolute(font)) {
+        return font;
+    }
+    std::string path = directory.empty() ? font : directory + "/" + font;
+    if (Filesystem::exists(path)) {
+        return path;
+    }
+    return font_path(font);
+}
+
+// compiles a json template of text blocks into plan, fonts are resolved
+// relative to directory
+static bool
+compile_template(const std::string& text, const std::string& directory, TemplatePlan& plan, std::string& error)
+{
+    JsonValue document;
+    JsonParser parser(text);
+    if (!parser.parse(document)) {
+        error = parser.error();
+        return false;
+    }
+    const JsonValue* blocks = &document;
+    if (document.type == JsonValue::Object) {
+        blocks = document.find("blocks");
+    }
+    if (!blocks || blocks->type != JsonValue::Array) {
+        error = "expected an array of blocks";
+        return false;
+    }
+    Hasher hasher;
+    hasher.add(text);
+    for (const JsonValue& object : blocks->values) {
+        if (object.type != JsonValue::Object || !object.find("text")) {
+            error = "expected block to be an object with text";
+            return false;
+        }
+        TemplateBlock block;
+        block.segments = template_segments(object.find("text")->str());
+        block.constant = std::none_of(block.segments.begin(), block.segments.end(),
+                                      [](const TemplateBlock::Segment& segment) { return segment.field; });
+        block.fontfile = tool.fontfile;
+        block.color = tool.color;
+        for (size_t i = 0; i < object.keys.size(); ++i) {
+            std::string key = Strutil::lower(object.keys[i]);
+            std::string value = Strutil::lower(object.values[i].str());
+            if (key == "font") {
+                block.fontfile = template_font(object.values[i].str(), directory);
+            } else if (key == "size") {
+                block.size = Strutil::stof(value);
+            } else if (key == "x") {
+                block.x = Strutil::stof(value);
+            } else if (key == "y") {
+                block.y = Strutil::stof(value);
+            } else if (key == "alignx") {
+                if (value == "left") {
+                    block.alignx = ImageBufAlgo::TextAlignX::Left;
+                } else if (value == "center") {
+                    block.alignx = ImageBufAlgo::TextAlignX::Center;
+                } else if (value == "right") {
+                    block.alignx = ImageBufAlgo::TextAlignX::Right;
+                } else {
+                    error = "unknown alignx, available options are left, center, right: " + value;
+                    return false;
+                }
+            } else if (key == "aligny") {
+                if (value == "top") {
+                    block.aligny = ImageBufAlgo::TextAlignY::Top;
+                } else if (value == "center") {
+                    block.aligny = ImageBufAlgo::TextAlignY::Center;
+                } else if (value == "bottom") {
+                    block.aligny = ImageBufAlgo::TextAlignY::Bottom;
+                } else if (value == "baseline") {
+                    block.aligny = ImageBufAlgo::TextAlignY::Baseline;
+                } else {
+                    error = "unknown aligny, available options are top, center, bottom, baseline: " + value;
+                    return false;
+                }
+            } else if (key == "color") {
+                if (!parse_color(value, block.color)) {
+                    error = "could not parse color from string: " + value;
+                    return false;
+                }
+            }
+        }
+        if (block.size <= 0.0f) {
+            error = "block has invalid size";
+            return false;
+        }
+        if (!Filesystem::exists(block.fontfile)) {
+            error = "could not find font file: " + block.fontfile;
+            return false;
+        }
+        hasher.add_value(FontRegistry::instance().hash(block.fontfile));
+        plan.blocks.push_back(block);
+    }
+    plan.hash = hasher.value();
+    return true;
+}
+
+// reads and compiles the layout template in filename
+static std::shared_ptr<const TemplatePlan>
+read_template(const std::string& filename)
+{
+    std::string text;
+    if (!Filesystem::read_text_file(filename, text)) {
+        print_error("could not read template file: ", filename);
+        return nullptr;
+    }
+    std::shared_ptr<TemplatePlan> plan = std::make_shared<TemplatePlan>();
+    std::string error;
+    if (!compile_template(text, Filesystem::parent_path(filename), *plan, error)) {
+        print_error("could not parse template file: ", error);
+        return nullptr;
+    }
+    return plan;
+}
+
+// returns a copy of plan where blocks whose text substitutes the same for
+// all cards are marked constant, their coverage is then rasterized once per
+// card size and shared
+static std::shared_ptr<const TemplatePlan>
+constant_blocks(const TemplatePlan& plan, const std::vector<TextCard>& cards)
+{
+    std::shared_ptr<TemplatePlan> constantplan = std::make_shared<TemplatePlan>(plan);
+    for (TemplateBlock& block : constantplan->blocks) {
+        if (block.constant || cards.empty()) {
+            continue;
+        }
+        std::string text = block.text(cards.front());
+        block.constant = std::all_of(cards.begin(), cards.end(),
+                                     [&](const TextCard& card) { return block.text(card) == text; });
+    }
+    return constantplan;
+}
+
+// utils - sequence
+
+// returns frame as a HH:MM:SS:FF timecode at fps frames per second
+static std::string
+frame_timecode(int frame, int fps)
+{
+    int seconds = frame / fps;
+    std::ostringstream oss;
+    oss << std::setfill('0') << std::setw(2) << seconds / 3600 << ":"
+        << std::setw(2) << (seconds / 60) % 60 << ":"
+        << std::setw(2) << seconds % 60 << ":"
+        << std::setw(2) << frame % fps;
+    return oss.str();
+}
+
+// substitutes {frame}, {timecode} and printf style %d and %0Nd frame numbers
+// in text, other text is kept as is
+static std::string
+frame_text(const std::string& text, int frame, int fps)
+{
+    std::string result;
+    for (size_t i = 0; i < text.size();) {
+        if (text.compare(i, 7, "{frame}") == 0) {
+            result += std::to_string(frame);
+            i += 7;
+            continue;
+        }
+        if (text.compare(i, 10, "{timecode}") == 0) {
+            result += frame_timecode(frame, fps);
+            i += 10;
+            continue;
+        }
+        if (text.compare(i, 2, "%%") == 0) {
+            result += '%';
+            i += 2;
+            continue;
+        }
+        if (text[i] == '%') {
+            size_t end = i + 1;
+            while (end < text.size() && isdigit(static_cast<unsigned char>(text[end]))) {
+                end++;
+            }
+            if (end < text.size() && text[end] == 'd' && (end == i + 1 || text[i + 1] == '0')) {
+                std::ostringstream oss;
+                oss << std::setfill('0') << std::setw(end > i + 1 ? Strutil::stoi(text.substr(i + 1, end - i - 1)) : 0) << frame;
+                result += oss.str();
+                i = end + 1;
+                continue;
+            }
+        }
+        result += text[i++];
+    }
+    return result;
+}
+
+// expands each card into one card per frame of the sequence, frame numbers
+// are substituted in title, subtitle, input and output file and template
+// fields and frame and timecode are available as template fields. frames of
+// a card stay adjacent so they can be drawn incrementally
+static std::vector<TextCard>
+sequence_cards(const std::vector<TextCard>& cards, Imath::Vec2<int> frames, int fps)
+{
+    std::vector<TextCard> sequence;
+    sequence.reserve(cards.size() * size_t(frames.y - frames.x + 1));
+    for (const TextCard& card : cards) {
+        for (int frame = frames.x; frame <= frames.y; ++frame) {
+            TextCard framecard = card;
+            framecard.title = frame_text(card.title, frame, fps);
+            framecard.subtitle = frame_text(card.subtitle, frame, fps);
+            framecard.outputfile = frame_text(card.outputfile, frame, fps);
+            framecard.inputfile = frame_text(card.inputfile, frame, fps);
+            for (std::pair<const std::string, std::string>& field : framecard.fields) {
+                field.second = frame_text(field.second, frame, fps);
+            }
+            framecard.fields["frame"] = std::to_string(frame);
+            framecard.fields["timecode"] = frame_timecode(frame, fps);
+            sequence.push_back(framecard);
+        }
+    }
+    return sequence;
+}
+
+// utils - format
+
+// returns the buffer format for outputfile, formats without more than 8 bits
+// of precision are rendered natively in uint8 unless a format is set
+static TypeDesc
+output_format(const std::string& outputfile)
+{
+    if (tool.format == "uint10") {
+        return TypeDesc::UINT16;
+    }
+    if (tool.format.size()) {
+        return TypeDesc(tool.format);
+    }
+    static const char* formats[] = { ".png", ".jpg", ".jpeg", ".bmp", ".gif", ".tga", ".ppm", ".webp" };
+    std::string extension = Strutil::lower(Filesystem::extension(outputfile));
+    for (const char* format : formats) {
+        if (extension == format) {
+            return TypeDesc::UINT8;
+        }
+    }
+    return TypeDesc::FLOAT;
+}
+
+// returns the bits per sample written to outputfile, 0 for float formats.
+// uint10 renders in uint16 and is written with 10 bits per sample
+static int
+output_bits(const std::string& outputfile)
+{
+    if (tool.format == "uint10") {
+        return 10;
+    }
+    TypeDesc format = output_format(outputfile);
+    if (format == TypeDesc::UINT8) {
+        return 8;
+    }
+    if (format == TypeDesc::UINT16) {
+        return 16;
+    }
+    return 0;
+}
+
+// returns the compression attribute for outputfile. the fast preset picks
+// the quickest lossless encoding per format and small the highest lossless
+// compression, other values are passed as is. empty keeps the format default
+static std::string
+output_compression(const std::string& outputfile)
+{
+    std::string extension = Strutil::lower(Filesystem::extension(outputfile));
+    bool tiff = extension == ".tif" || extension == ".tiff";
+    if (tool.compression == "fast") {
+        if (extension == ".exr") {
+            return "zips";
+        }
+        if (tiff) {
+            return "none";
+        }
+        if (extension == ".png") {
+            return "zip:1";
+        }
+        return "";
+    }
+    if (tool.compression == "small") {
+        if (extension == ".exr" || extension == ".png" || tiff) {
+            return "zip:9";
+        }
+        return "";
+    }
+    return tool.compression;
+}
+
+// sets the compression and quality attributes forwarded to the image writer
+// of outputfile, attributes without options are left as is
+static void
+output_attributes(ImageSpec& spec, const std::string& outputfile)
+{
+    std::string compression = output_compression(outputfile);
+    if (compression.size()) {
+        spec.attribute("compression", compression);
+    }
+    if (tool.quality > 0) {
+        spec.attribute("CompressionQuality", tool.quality);
+    }
+}
+
+// returns true if outputfile is encoded lossily, by a lossy format or a lossy
+// compression such as dwaa or b44
+static bool
+lossy_output(const std::string& outputfile, const std::string& compression)
+{
+    static const char* formats[] = { ".jpg", ".jpeg", ".webp" };
+    std::string extension = Strutil::lower(Filesystem::extension(outputfile));
+    for (const char* format : formats) {
+        if (extension == format) {
+            return true;
+        }
+    }
+    static const char* compressions[] = { "dwaa", "dwab", "b44", "b44a", "pxr24", "jpeg" };
+    std::string name = Strutil::lower(compression.substr(0, compression.find(':')));
+    for (const char* lossy : compressions) {
+        if (name == lossy) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// utils - cache
+
+// content addressed cache of output files keyed by a hash of all card
+// parameters, the font file contents and the tool version. entries live in
+// their own subdirectory of the cache directory and are evicted least
+// recently used first when the cache exceeds its size limit. outputs are
+// always copies of entries, so rewriting an output never changes the cache.
+class OutputCache
+{
+public:
+    static OutputCache& instance() {
+        static OutputCache cache;
+        return cache;
+    }
+    
+    bool open(const std::string& directory, size_t limit) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string error;
+        std::string entries = directory + "/entries";
+        if (!Filesystem::is_directory(entries) && !Filesystem::create_directories(entries, error)) {
+            print_error("could not create cache directory: ", entries);
+            return false;
+        }
+        m_directory = entries;
+        m_limit = limit;
+        
+        // only files named as entries are indexed, anything else in the
+        // directory is never evicted
+        std::vector<std::string> files;
+        Filesystem::get_directory_entries(entries, files, false);
+        std::vector<std::pair<std::time_t, std::string>> found;
+        for (const std::string& file : files) {
+            if (is_entry(Filesystem::filename(file)) && Filesystem::is_regular(file)) {
+                found.push_back(std::make_pair(Filesystem::last_write_time(file), file));
+            }
+        }
+        std::sort(found.begin(), found.end());
+        for (const std::pair<std::time_t, std::string>& file : found) {
+            touch_locked(file.second, Filesystem::file_size(file.second));
+        }
+        evict_locked();
+        return true;
+    }
+    
+    bool enabled() const { return m_directory.size() > 0; }
+    
+    std::string path(const TextCard& card) const {
+        std::string extension = Strutil::lower(Filesystem::extension(card.outputfile));
+        Hasher hasher;
+        hasher.add(std::string(texttool_version))
+              .add(card.title)
+              .add(card.subtitle)
+              .add(card.gradient)
+              .add(extension)
+              .add_value(card.size.x)
+              .add_value(card.size.y)
+              .add_value(output_format(card.outputfile).basetype)
+              .add_value(output_bits(card.outputfile))
+              .add_value(tool.dither)
+              .add(output_compression(card.outputfile))
+              .add_value(tool.quality)
+              .add_value(FontRegistry::instance().hash(tool.fontfile));
+        for (int c = 0; c < 3; ++c) {
+            hasher.add_value(tool.color[c]).add_value(tool.background[c]);
+        }
+        if (card.inputfile.size()) {
+            hasher.add(card.inputfile)
+                  .add_value(Filesystem::file_size(card.inputfile))
+                  .add_value(static_cast<int64_t>(Filesystem::last_write_time(card.inputfile)));
+        }
+        if (tool.plan) {
+            hasher.add_value(tool.plan->hash);
+            for (const std::pair<const std::string, std::string>& field : card.fields) {
+                hasher.add(field.first).add(field.second);
+            }
+        }
+        return m_directory + "/" + hasher.hex() + extension;
+    }
+    
+    // copies a cached file to outputfile and marks it as recently used
+    bool fetch(const std::string& cachefile, const std::string& outputfile) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::map<std::string, Entry>::iterator it = m_entries.find(cachefile);
+            if (it == m_entries.end()) {
+                m_misses++;
+                return false;
+            }
+            m_order.splice(m_order.begin(), m_order, it->second.order);
+        }
+        // copied outside the lock, an entry evicted meanwhile is a miss
+        std::string error;
+        std::string tempfile = temp_path(outputfile);
+        if (!Filesystem::copy(cachefile, tempfile, error)) {
+            Filesystem::remove(tempfile, error);
+            m_misses++;
+            return false;
+        }
+        if (!replace_file(tempfile, outputfile)) {
+            m_misses++;
+            return false;
+        }
+        Filesystem::last_write_time(cachefile, std::time(nullptr));
+        m_hits++;
+        return true;
+    }
+    
+    // adds a copy of outputfile to the cache. written under a temporary name
+    // and renamed so that concurrent readers never see partial files
+    void store(const std::string& outputfile, const std::string& cachefile) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string error;
+        std::string tempfile = Filesystem::unique_path(cachefile + ".%%%%%%%%.tmp");
+        if (!Filesystem::copy(outputfile, tempfile, error) || !Filesystem::rename(tempfile, cachefile, error)) {
+            Filesystem::remove(tempfile, error);
+            print_warning("could not store output file in cache: ", outputfile);
+            return;
+        }
+        touch_locked(cachefile, Filesystem::file_size(cachefile));
+        evict_locked();
+    }
+    
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+
+private:
+    struct Entry
+    {
+        uint64_t size = 0;
+        std::list<std::string>::iterator order;
+    };
+    
+    OutputCache() : m_limit(0), m_bytes(0), m_hits(0), m_misses(0) {}
+    
+    // entry names are the 16 digit hex hash followed by the extension
+    static bool is_entry(const std::string& name) {
+        size_t dot = name.find('.');
+        if (dot != 16 || name.find('.', dot + 1) != std::string::npos) {
+            return false;
+        }
+        return std::all_of(name.begin(), name.begin() + dot, [](char c) {
+            return std::isdigit(static_cast<unsigned char>(c)) || (c >= 'a' && c <= 'f');
+        });
+    }
+    
+    // adds or updates cachefile as the most recently used entry
+    void touch_locked(const std::string& cachefile, uint64_t size) {
+        std::map<std::string, Entry>::iterator it = m_entries.find(cachefile);
+        if (it == m_entries.end()) {
+            m_order.push_front(cachefile);
+            it = m_entries.insert(std::make_pair(cachefile, Entry())).first;
+            it->second.order = m_order.begin();
+        } else {
+            m_order.splice(m_order.begin(), m_order, it->second.order);
+        }
+        m_bytes -= it->second.size;
+        it->second.size = size;
+        m_bytes += size;
+    }
+    
+    void evict_locked() {
+        while (m_bytes > m_limit && !m_order.empty()) {
+            std::map<std::string, Entry>::iterator it = m_entries.find(m_order.back());
+            std::string error;
+            Filesystem::remove(it->first, error);
+            m_bytes -= it->second.size;
+            m_entries.erase(it);
+            m_order.pop_back();
+        }
+    }
+    
+    std::mutex m_mutex;
+    std::string m_directory;
+    uint64_t m_limit;
+    uint64_t m_bytes;
+    std::map<std::string, Entry> m_entries;
+    std::list<std::string> m_order; // most recently used first
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+};
+
+// shared image cache for the input plates of overlay sequences, bounded by
+// memory and open files. scanline plates are autotiled so that bands only
+// pull the tiles they cross
+class PlateCache
+{
+public:
+    static PlateCache& instance() {
+        static PlateCache cache;
+        return cache;
+    }
+    
+    void open(int memory, int files) {
+        m_imagecache = ImageCache::create(true);
+        m_imagecache->attribute("max_memory_MB", static_cast<float>(memory));
+        m_imagecache->attribute("max_open_files", files);
+        m_imagecache->attribute("autotile", 64);
+    }
+    
+    bool enabled() const { return m_imagecache != nullptr; }
+    ImageCache* imagecache() const { return m_imagecache; }
+    
+    // reads all tiles of filename into the cache in the background
+    std::future<void> prefetch(const std::string& filename) {
+        return std::async(std::launch::async, [this, filename] {
+            ustring name(filename);
+            ImageSpec spec;
+            if (!m_imagecache->get_imagespec(name, spec)) {
+                m_imagecache->geterror();
+                return;
+            }
+            int tilewidth = spec.tile_width > 0 ? spec.tile_width : spec.width;
+            int tileheight = spec.tile_height > 0 ? spec.tile_height : spec.height;
+            for (int y = spec.y; y < spec.y + spec.height; y += tileheight) {
+                for (int x = spec.x; x < spec.x + spec.width; x += tilewidth) {
+                    ImageCache::Tile* tile = m_imagecache->get_tile(name, 0, 0, x, y, spec.z);
+                    if (tile) {
+                        m_imagecache->release_tile(tile);
+                    }
+                }
+            }
+            m_prefetches++;
+        });
+    }
+    
+    // drops filename from the cache once no later frame reads it
+    void release(const std::string& filename) {
+        m_imagecache->invalidate(ustring(filename));
+    }
+    
+    size_t prefetches() const { return m_prefetches; }
+
+private:
+    PlateCache() : m_imagecache(nullptr), m_prefetches(0) {}
+    
+    ImageCache* m_imagecache;
+    std::atomic<size_t> m_prefetches;
+};
+
+// stats
+struct StageStats
+{
+    double wall = 0.0;
+    double cpu = 0.0;
+};
+
+struct CardStats
+{
+    std::string outputfile;
+    StageStats read; // input plate, overlays only
+    StageStats alloc;
+    StageStats background;
+    StageStats layout;
+    StageStats title;
+    StageStats subtitle;
+    StageStats queue; // waiting for a free write queue slot
+    StageStats write; // encoding, on a writer thread when queued
+    size_t queuedepth = 0; // cards queued for writing ahead of this one
+    size_t peakrss = 0;
+    
+    double text() const { return title.wall + subtitle.wall; }
+    double total() const { return read.wall + alloc.wall + background.wall + layout.wall + text() + queue.wall + write.wall; }
+};
+
+// returns cpu time in seconds for the calling thread or the whole process
+static double
+cpu_time(bool thread)
+{
+#ifndef _WIN32
+    timespec ts;
+    clock_gettime(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + ts.tv_nsec * 1e-9;
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+// returns peak resident set size of the process in bytes
+static size_t
+peak_rss()
+{
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#  ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#  else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#  endif
+#else
+    return Sysutil::memory_used(true);
+#endif
+}
+
+// accumulates wall and cpu time between laps into stages. cards rendered on
+// a single thread measure thread cpu time, multithreaded cards measure
+// process cpu time to include the worker threads.
+class StageTimer
+{
+public:
+    StageTimer(bool threadcpu) : m_threadcpu(threadcpu) { restart(); }
+    
+    void lap(CardStats& stats, StageStats& stage) {
+        double cpu = cpu_time(m_threadcpu);
+        stage.wall += m_timer.lap();
+        stage.cpu += cpu - m_cpu;
+        m_cpu = cpu;
+        stats.peakrss = std::max(stats.peakrss, peak_rss());
+    }
+    
+    void restart() {
+        m_timer.lap();
+        m_cpu = cpu_time(m_threadcpu);
+    }
+
+private:
+    Timer m_timer;
+    double m_cpu;
+    bool m_threadcpu;
+};
+
+static void
+print_stats(const CardStats& stats)
+{
+    const std::pair<const char*, const StageStats*> stages[] = {
+        { "read", &stats.read },
+        { "alloc", &stats.alloc },
+        { "background", &stats.background },
+        { "layout", &stats.layout },
+        { "title", &stats.title },
+        { "subtitle", &stats.subtitle },
+        { "queue", &stats.queue },
+        { "write", &stats.write }
+    };
+    std::ostringstream oss;
+    oss << std::fixed;
+    oss.precision(2);
+    for (const std::pair<const char*, const StageStats*>& stage : stages) {
+        oss << stage.first << " " << 1000.0 * stage.second->wall << " ms"
+            << " (cpu " << 1000.0 * stage.second->cpu << " ms), ";
+    }
+    oss << "queue depth " << stats.queuedepth << ", peak rss " << stats.peakrss / (1024 * 1024) << " MB";
+    std::lock_guard<std::mutex> lock(print_mutex());
+    std::cerr << "stats: " << stats.outputfile << ": " << oss.str() << std::endl;
+}
+
+static void
+write_stage_json(std::ostream& os, const char* name, const StageStats& stage, bool last = false)
+{
+    os << "\"" << name << "\": { \"wall_ms\": " << 1000.0 * stage.wall
+       << ", \"cpu_ms\": " << 1000.0 * stage.cpu << " }" << (last ? "" : ", ");
+}
+
+static void
+write_stats_json(std::ostream& os, const CardStats& stats)
+{
+    os << "\"stages\": { ";
+    write_stage_json(os, "read", stats.read);
+    write_stage_json(os, "alloc", stats.alloc);
+    write_stage_json(os, "background", stats.background);
+    write_stage_json(os, "layout", stats.layout);
+    write_stage_json(os, "title", stats.title);
+    write_stage_json(os, "subtitle", stats.subtitle);
+    write_stage_json(os, "queue", stats.queue);
+    write_stage_json(os, "write", stats.write, true);
+    os << " }, \"queue_depth\": " << stats.queuedepth
+       << ", \"peak_rss_mb\": " << stats.peakrss / (1024.0 * 1024.0);
+}
+
+// writes per card and total stage timings as json
+static bool
+write_stats(const std::string& statsfile, const std::vector<CardStats>& cards, double elapsed)
+{
+    CardStats totals;
+    totals.outputfile = "totals";
+    for (const CardStats& card : cards) {
+        StageStats CardStats::* stages[] = {
+            &CardStats::read, &CardStats::alloc, &CardStats::background, &CardStats::layout,
+            &CardStats::title, &CardStats::subtitle, &CardStats::queue, &CardStats::write
+        };
+        for (StageStats CardStats::* stage : stages) {
+            (totals.*stage).wall += (card.*stage).wall;
+            (totals.*stage).cpu += (card.*stage).cpu;
+        }
+        totals.queuedepth = std::max(totals.queuedepth, card.queuedepth);
+        totals.peakrss = std::max(totals.peakrss, card.peakrss);
+    }
+    std::ofstream file(statsfile);
+    if (!file) {
+        print_error("could not write stats file: ", statsfile);
+        return false;
+    }
+    file << "{\n"
+         << "  \"threads\": " << tool.threads << ",\n"
+         << "  \"elapsed_ms\": " << 1000.0 * elapsed << ",\n"
+         << "  \"cards_per_sec\": " << (elapsed > 0.0 ? cards.size() / elapsed : 0.0) << ",\n"
+         << "  \"totals\": { ";
+    write_stats_json(file, totals);
+    file << " },\n"
+         << "  \"cards\": [\n";
+    for (size_t i = 0; i < cards.size(); ++i) {
+        file << "    { \"outputfile\": \"" << json_escape(cards[i].outputfile) << "\", ";
+        write_stats_json(file, cards[i]);
+        file << " }" << (i + 1 < cards.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n"
+         << "}\n";
+    return true;
+}
+
+// render
+
+// text shaped once, measured and rasterized from the same glyphs, aligned
+// at x, y in color
+struct TextBlock
+{
+    TextLayout text;
+    int x = 0;
+    int y = 0;
+    ImageBufAlgo::TextAlignX alignx = ImageBufAlgo::TextAlignX::Center;
+    ImageBufAlgo::TextAlignY aligny = ImageBufAlgo::TextAlignY::Top;
+    Imath::Vec3<float> color;
+    
+    ROI roi() const { return text_roi(text, x, y, alignx, aligny); }
+};
+
+// shapes and places a template block on a card covering roi
+static bool
+place_block(const TemplateBlock& templateblock, const TextCard& card, ROI roi, TextBlock& block)
+{
+    std::shared_ptr<FontFace> font = FontRegistry::instance().face(templateblock.fontfile, std::max(1, static_cast<int>(roi.height() * templateblock.size)));
+    if (!font) {
+        return false;
+    }
+    block.text = shape_text(templateblock.text(card), *font);
+    block.x = roi.xbegin + static_cast<int>(roi.width() * templateblock.x);
+    block.y = roi.ybegin + static_cast<int>(roi.height() * templateblock.y);
+    block.alignx = templateblock.alignx;
+    block.aligny = templateblock.aligny;
+    block.color = templateblock.color;
+    return true;
+}
+
+// rasterizes block coverage within roi, null if the block is outside roi
+static std::shared_ptr<const TextMask>
+rasterize_block(const TextBlock& block, ROI roi)
+{
+    ROI maskroi = roi_intersection(block.roi(), roi);
+    if (maskroi.width() <= 0 || maskroi.height() <= 0) {
+        return nullptr;
+    }
+    std::shared_ptr<TextMask> mask = std::make_shared<TextMask>();
+    mask->reset(maskroi, block.color);
+    rasterize_text(*mask, block.x, block.y, block.text, block.alignx, block.aligny);
+    return mask;
+}
+
+// constant template blocks shaped and rasterized once for a card size,
+// indexed as the template blocks with variable blocks left empty
+struct TemplateLayer
+{
+    std::vector<TextBlock> blocks;
+    std::vector<std::shared_ptr<const TextMask>> masks;
+};
+
+// caches one template layer per template and card size, shared by all cards.
+// least recently used layers are dropped once the budget is exceeded
+class LayerCache
+{
+public:
+    static LayerCache& instance() {
+        static LayerCache cache;
+        return cache;
+    }
+    
+    void set_budget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_budget = bytes;
+        evict();
+    }
+    
+    std::shared_ptr<const TemplateLayer> layer(const TemplatePlan& plan, const TextCard& card) {
+        Key key(&plan, std::make_pair(card.size.x, card.size.y));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::map<Key, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+            if (it != m_index.end()) {
+                m_entries.splice(m_entries.begin(), m_entries, it->second);
+                m_hits++;
+                return it->second->layer;
+            }
+        }
+        ROI roi(0, card.size.x, 0, card.size.y);
+        std::shared_ptr<TemplateLayer> layer = std::make_shared<TemplateLayer>();
+        layer->blocks.resize(plan.blocks.size());
+        layer->masks.resize(plan.blocks.size());
+        for (size_t i = 0; i < plan.blocks.size(); ++i) {
+            if (plan.blocks[i].constant) {
+                if (!place_block(plan.blocks[i], card, roi, layer->blocks[i])) {
+                    return nullptr;
+                }
+                layer->masks[i] = rasterize_block(layer->blocks[i], roi);
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_misses++;
+        std::map<Key, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+        if (it != m_index.end()) {
+            return it->second->layer;
+        }
+        Entry entry;
+        entry.key = key;
+        entry.layer = layer;
+        m_entries.push_front(entry);
+        m_index[key] = m_entries.begin();
+        m_bytes += bytes(*layer);
+        evict();
+        return layer;
+    }
+    
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+    size_t memory() const { return m_bytes; }
+
+private:
+    typedef std::pair<const TemplatePlan*, std::pair<int, int>> Key;
+    
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<const TemplateLayer> layer;
+    };
+    
+    LayerCache() : m_bytes(0), m_budget(64 * 1024 * 1024), m_hits(0), m_misses(0) {}
+    
+    // mask coverage and placed glyphs, glyph bitmaps are owned by the glyph cache
+    static size_t bytes(const TemplateLayer& layer) {
+        size_t size = sizeof(TemplateLayer);
+        for (const TextBlock& block : layer.blocks) {
+            size += sizeof(TextBlock) + block.text.glyphs.size() * sizeof(TextLayout::Glyph);
+        }
+        for (const std::shared_ptr<const TextMask>& mask : layer.masks) {
+            if (mask) {
+                size += sizeof(TextMask) + mask->coverage.size();
+            }
+        }
+        return size;
+    }
+    
+    // layers still used by a card are kept alive by their shared pointers
+    void evict() {
+        while (m_bytes > m_budget && !m_entries.empty()) {
+            Entry& entry = m_entries.back();
+            m_bytes -= bytes(*entry.layer);
+            m_index.erase(entry.key);
+            m_entries.pop_back();
+        }
+    }
+    
+    std::mutex m_mutex;
+    std::list<Entry> m_entries;
+    std::map<Key, std::list<Entry>::iterator> m_index;
+    size_t m_bytes;
+    size_t m_budget;
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+};
+
+struct CardLayout
+{
+    ROI roi;
+    Gradient gradient; // a single stop for a solid background
+    int dither = 0; // bits per sample gradients are dithered to, 0 for none
+    std::vector<TextBlock> blocks; // title and subtitle, or template blocks
+    ROI damage; // union of all text rects, text is only composited here
+    std::vector<std::shared_ptr<const TextMask>> masks; // coverage per block, null outside the canvas
+};
+
+// resolves background, fonts and text positions for card, shared by all bands
+static bool
+layout_card(const TextCard& card, CardLayout& layout)
+{
+    // title
+    ROI roi(0, card.size.x, 0, card.size.y);
+    int height = roi.height();
+    int titlesize = height * 0.2;
+    int subtitlesize = height * 0.1;
+    int center = roi.ybegin + height / 2;
+    int spacing = height * 0.08;
+    layout.roi = roi;
+    
+    // background
+    if (card.gradient.size() > 0)
+    {
+        if (!parse_gradient(card.gradient, layout.gradient)) {
+            layout.gradient.stops.clear();
+            print_warning("could not parse gradient: ", card.gradient);
+            std::string options;
+            for (const std::pair<const std::string, float>& pair : gradient_hues()) {
+                if (options.size()) {
+                    options += ", ";
+                }
+                options += pair.first;
+            }
+            print_warning("available hues are: ", options);
+            print_warning("or stops as [mode:]color[@position],... with mode vertical, horizontal, diagonal, radial or degrees");
+        } else {
+            int bits = output_bits(card.outputfile);
+            if (tool.dither && bits > 0 && bits <= 10) {
+                layout.dither = bits;
+            }
+        }
+    }
+    if (layout.gradient.stops.empty()) {
+        layout.gradient = Gradient();
+        layout.gradient.stops.resize(1);
+        layout.gradient.stops[0].color = tool.background;
+    }
+    
+    // text
+    if (tool.plan) {
+        std::shared_ptr<const TemplateLayer> layer = LayerCache::instance().layer(*tool.plan, card);
+        if (!layer) {
+            return false;
+        }
+        layout.blocks = layer->blocks;
+        layout.masks = layer->masks;
+        for (size_t i = 0; i < tool.plan->blocks.size(); ++i) {
+            if (!tool.plan->blocks[i].constant && !place_block(tool.plan->blocks[i], card, roi, layout.blocks[i])) {
+                return false;
+            }
+        }
+    } else {
+        std::shared_ptr<FontFace> titlefont = FontRegistry::instance().face(tool.fontfile, titlesize);
+        std::shared_ptr<FontFace> subtitlefont = FontRegistry::instance().face(tool.fontfile, subtitlesize);
+        if (!titlefont || !subtitlefont) {
+            return false;
+        }
+        TextBlock title;
+        title.text = shape_text(card.title, *titlefont);
+        title.color = tool.color;
+        TextBlock subtitle;
+        subtitle.text = shape_text(card.subtitle, *subtitlefont);
+        subtitle.color = tool.color;
+        
+        // center
+        int textheight = title.text.bounds.height() + spacing + subtitle.text.bounds.height();
+        title.x = roi.xbegin + roi.width() / 2;
+        title.y = center - (textheight / 2);
+        subtitle.x = title.x;
+        subtitle.y = title.y + title.text.bounds.height() + spacing;
+        layout.blocks.push_back(title);
+        layout.blocks.push_back(subtitle);
+    }
+    
+    // damage
+    {
+        layout.damage = ROI(0, 0, 0, 0);
+        for (const TextBlock& block : layout.blocks) {
+            ROI textroi = block.roi();
+            if (textroi.npixels() > 0) {
+                layout.damage = layout.damage.npixels() > 0 ? roi_union(layout.damage, textroi) : textroi;
+            }
+        }
+        layout.damage = roi_intersection(layout.damage, roi);
+        if (tool.debug) {
+            std::ostringstream oss;
+            oss << layout.damage.xbegin << ", " << layout.damage.ybegin << " - "
+                << layout.damage.xend << ", " << layout.damage.yend
+                << " (" << std::max(0.0, 100.0 * layout.damage.npixels() / roi.npixels()) << "% of canvas)";
+            print_info("Text damage region: ", oss.str());
+        }
+    }
+    return true;
+}
+
+// rasterizes the coverage of each text block within the canvas once, shared
+// by all bands. blocks from a template layer are already rasterized. the
+// first block is timed as title and the rest as subtitle
+static void
+rasterize_card(CardLayout& layout, CardStats* stats = nullptr)
+{
+    StageTimer timer(true);
+    layout.masks.resize(layout.blocks.size());
+    for (size_t i = 0; i < layout.blocks.size(); ++i) {
+        if (!layout.masks[i]) {
+            layout.masks[i] = rasterize_block(layout.blocks[i], layout.roi);
+        }
+        if (stats) {
+            timer.lap(*stats, i == 0 ? stats->title : stats->subtitle);
+        }
+    }
+}
+
+// draws the card into imagebuf, which may hold the full canvas or a band of
+// it. background and text are composited in one pass
+static void
+draw_card(ImageBuf& imagebuf, const CardLayout& layout, int nthreads, CardStats* stats = nullptr)
+{
+    StageTimer timer(nthreads == 1);
+    draw_composite(
+            imagebuf,
+            layout.roi,
+            layout.gradient,
+            layout.dither,
+            layout.masks,
+            nthreads
+    );
+    if (stats) {
+        timer.lap(*stats, stats->background);
+    }
+}
+
+// canvas kept between the frames of a sequence, holding the last frame drawn
+// and its layout so that the next frame only redraws what changed
+struct FrameCanvas
+{
+    ImageBuf imagebuf;
+    std::string gradient;
+    CardLayout layout;
+    
+    // returns true if card with layout can be drawn over the frame in imagebuf
+    bool reusable(const TextCard& card, const ImageSpec& spec, const CardLayout& cardlayout) const {
+        const ImageSpec& canvasspec = imagebuf.spec();
+        return imagebuf.initialized()
+            && canvasspec.width == spec.width && canvasspec.height == spec.height
+            && canvasspec.nchannels == spec.nchannels && canvasspec.format == spec.format
+            && gradient == card.gradient && layout.dither == cardlayout.dither
+            && layout.masks.size() == cardlayout.masks.size();
+    }
+};
+
+// returns the rect of pixels whose coverage differs between masks, empty if
+// both masks are the same. masks of different colors differ everywhere
+static ROI
+mask_damage(const TextMask* previous, const TextMask* mask)
+{
+    if (previous == mask) {
+        return ROI(0, 0, 0, 0);
+    }
+    if (!previous || !mask) {
+        return previous ? previous->roi : mask->roi;
+    }
+    ROI roi = roi_union(previous->roi, mask->roi);
+    if (previous->color != mask->color) {
+        return roi;
+    }
+    int xbegin = roi.xend, xend = roi.xbegin;
+    int ybegin = roi.yend, yend = roi.ybegin;
+    for (int y = roi.ybegin; y < roi.yend; ++y) {
+        bool inprevious = y >= previous->roi.ybegin && y < previous->roi.yend;
+        bool inmask = y >= mask->roi.ybegin && y < mask->roi.yend;
+        for (int x = roi.xbegin; x < roi.xend; ++x) {
+            unsigned char a = inprevious && x >= previous->roi.xbegin && x < previous->roi.xend ? previous->row(y)[x - previous->roi.xbegin] : 0;
+            unsigned char b = inmask && x >= mask->roi.xbegin && x < mask->roi.xend ? mask->row(y)[x - mask->roi.xbegin] : 0;
+            if (a != b) {
+                xbegin = std::min(xbegin, x);
+                xend = std::max(xend, x + 1);
+                ybegin = std::min(ybegin, y);
+                yend = std::max(yend, y + 1);
+            }
+        }
+    }
+    return xbegin < xend ? ROI(xbegin, xend, ybegin, yend) : ROI(0, 0, 0, 0);
+}
+
+// draws the card over the previous frame in canvas, only the rects where
+// block coverage changed are composited again
+static void
+draw_frame(FrameCanvas& canvas, const CardLayout& layout, int nthreads, CardStats* stats = nullptr)
+{
+    StageTimer timer(nthreads == 1);
+    imagesize_t npixels = 0;
+    for (size_t i = 0; i < layout.masks.size(); ++i) {
+        ROI damage = mask_damage(canvas.layout.masks[i].get(), layout.masks[i].get());
+        if (damage.npixels() > 0) {
+            draw_composite(canvas.imagebuf, layout.roi, layout.gradient, layout.dither, layout.masks, nthreads, damage);
+            npixels += damage.npixels();
+        }
+    }
+    if (tool.debug) {
+        std::ostringstream oss;
+        oss << npixels << " pixels (" << 100.0 * npixels / layout.roi.npixels() << "% of canvas)";
+        print_info("Frame damage region: ", oss.str());
+    }
+    if (stats) {
+        timer.lap(*stats, stats->background);
+    }
+}
+
+// renders the card band by band into a single reused band buffer and writes
+// each band as scanlines, peak memory is bounded by the band height
+static bool
+stream_card(const TextCard& card, const CardLayout& layout, const ImageSpec& spec, int nthreads, CardStats* stats)
+{
+    StageTimer timer(nthreads == 1);
+    ImageOutput::unique_ptr output = ImageOutput::create(card.outputfile);
+    if (!output) {
+        print_error("could not create output file: ", card.outputfile);
+        return false;
+    }
+    std::string tempfile = temp_path(card.outputfile);
+    std::string error;
+    if (!output->open(tempfile, spec)) {
+        print_error("could not open output file: ", output->geterror());
+        return false;
+    }
+    int bandheight = std::min(tool.stream, spec.height);
+    std::vector<char> pixels(size_t(bandheight) * spec.scanline_bytes());
+    if (stats) {
+        timer.lap(*stats, stats->alloc);
+    }
+    for (int ybegin = spec.y; ybegin < spec.y + spec.height; ybegin += bandheight) {
+        ImageSpec bandspec = spec;
+        bandspec.y = ybegin;
+        bandspec.height = std::min(bandheight, spec.y + spec.height - ybegin);
+        ImageBuf band(bandspec, pixels.data());
+        draw_card(band, layout, nthreads, stats);
+        timer.restart();
+        if (!output->write_scanlines(bandspec.y, bandspec.y + bandspec.height, 0, spec.format, pixels.data())) {
+            print_error("could not write output file: ", output->geterror());
+            output->close();
+            Filesystem::remove(tempfile, error);
+            return false;
+        }
+        if (stats) {
+            timer.lap(*stats, stats->write);
+        }
+    }
+    if (!output->close()) {
+        print_error("could not close output file: ", output->geterror());
+        Filesystem::remove(tempfile, error);
+        return false;
+    }
+    if (!replace_file(tempfile, card.outputfile)) {
+        return false;
+    }
+    if (stats) {
+        timer.lap(*stats, stats->write);
+    }
+    return true;
+}
+
+// composites the card text onto its input plate band by band. bands are
+// read and written as tiles when both files support them, otherwise as
+// scanlines, and only bands crossing the text are touched, rows in parallel.
+// plates of sequences are read through the plate cache. the plate keeps its
+// size, channels and pixel type, peak memory is bounded by the band height.
+// the output is renamed into place once complete, so the output file may be
+// the plate itself
+static bool
+overlay_card(const TextCard& card, int nthreads, CardStats* stats, std::vector<unsigned char>* encoded)
+{
+    StageTimer timer(nthreads == 1);
+    ImageCache* imagecache = PlateCache::instance().imagecache();
+    ustring inputname(card.inputfile);
+    ImageInput::unique_ptr input;
+    ImageSpec spec;
+    if (imagecache) {
+        if (!imagecache->get_imagespec(inputname, spec, 0, 0, true)) {
+            print_error("could not open input file: ", imagecache->geterror());
+            return false;
+        }
+    } else {
+        input = ImageInput::open(card.inputfile);
+        if (!input) {
+            print_error("could not open input file: ", card.inputfile);
+            return false;
+        }
+        spec = input->spec();
+    }
+    TextCard platecard = card;
+    platecard.size = Imath::Vec2<int>(spec.width, spec.height);
+    CardLayout layout;
+    if (!layout_card(platecard, layout)) {
+        return false;
+    }
+    if (stats) {
+        stats->outputfile = card.outputfile;
+        timer.lap(*stats, stats->layout);
+    }
+    rasterize_card(layout, stats);
+    timer.restart();
+    
+    // text is laid out from the data window origin
+    if (spec.x || spec.y) {
+        for (std::shared_ptr<const TextMask>& mask : layout.masks) {
+            if (mask) {
+                std::shared_ptr<TextMask> moved = std::make_shared<TextMask>(*mask);
+                moved->roi.xbegin += spec.x;
+                moved->roi.xend += spec.x;
+                moved->roi.ybegin += spec.y;
+                moved->roi.yend += spec.y;
+                mask = moved;
+            }
+        }
+    }
+    
+    ImageOutput::unique_ptr output = ImageOutput::create(card.outputfile);
+    if (!output) {
+        print_error("could not create output file: ", card.outputfile);
+        return false;
+    }
+    std::unique_ptr<Filesystem::IOVecOutput> proxy;
+    if (encoded) {
+        if (!output->supports("ioproxy")) {
+            print_error("could not encode output format in memory: ", card.outputfile);
+            return false;
+        }
+        encoded->clear();
+        proxy.reset(new Filesystem::IOVecOutput(*encoded));
+        output->set_ioproxy(proxy.get());
+    }
+    bool tiled = spec.tile_width > 0 && output->supports("tiles");
+    ImageSpec outputspec = spec;
+    if (!tiled) {
+        outputspec.tile_width = outputspec.tile_height = outputspec.tile_depth = 0;
+    }
+    output_attributes(outputspec, card.outputfile);
+    
+    // every band is decoded and encoded again, not only those with text
+    std::string compression = outputspec.get_string_attribute("compression");
+    if (lossy_output(card.outputfile, compression)) {
+        static std::once_flag warned;
+        std::call_once(warned, [&card, &compression] {
+            print_warning("plate is encoded again with lossy compression, the whole frame loses quality: ",
+                          card.outputfile + (compression.size() ? " (" + compression + ")" : std::string()));
+        });
+    }
+    std::string tempfile = encoded ? card.outputfile : temp_path(card.outputfile);
+    std::string error;
+    if (!output->open(tempfile, outputspec)) {
+        print_error("could not open output file: ", output->geterror());
+        return false;
+    }
+    
+    // other pixel types are composited in float and converted on write
+    TypeDesc format = spec.format;
+    if (format != TypeDesc::UINT8 && format != TypeDesc::UINT16 && format != TypeDesc::HALF && format != TypeDesc::FLOAT) {
+        format = TypeFloat;
+    }
+    int bandheight = std::min(tool.stream > 0 ? tool.stream : 64, spec.height);
+    if (tiled) {
+        bandheight = std::max(1, bandheight / spec.tile_height) * spec.tile_height;
+    }
+    ImageSpec bandspec(spec.width, bandheight, spec.nchannels, format);
+    std::vector<char> pixels(size_t(bandheight) * bandspec.scanline_bytes());
+    if (stats) {
+        timer.lap(*stats, stats->alloc);
+    }
+    for (int ybegin = spec.y; ybegin < spec.y + spec.height; ybegin += bandheight) {
+        int yend = std::min(ybegin + bandheight, spec.y + spec.height);
+        bool ok;
+        if (imagecache) {
+            ok = imagecache->get_pixels(inputname, 0, 0, spec.x, spec.x + spec.width, ybegin, yend, spec.z, spec.z + std::max(1, spec.depth),
+                                        0, spec.nchannels, format, pixels.data());
+        } else if (tiled) {
+            ok = input->read_tiles(0, 0, spec.x, spec.x + spec.width, ybegin, yend, spec.z, spec.z + std::max(1, spec.depth),
+                                   0, spec.nchannels, format, pixels.data());
+        } else {
+            ok = input->read_scanlines(0, 0, ybegin, yend, spec.z, 0, spec.nchannels, format, pixels.data());
+        }
+        if (!ok) {
+            print_error("could not read input file: ", imagecache ? imagecache->geterror() : input->geterror());
+            output->close();
+            Filesystem::remove(tempfile, error);
+            return false;
+        }
+        if (stats) {
+            timer.lap(*stats, stats->read);
+        }
+        if (ybegin < layout.damage.yend + spec.y && yend > layout.damage.ybegin + spec.y) {
+            bandspec.x = spec.x;
+            bandspec.y = ybegin;
+            bandspec.height = yend - ybegin;
+            ImageBuf band(bandspec, pixels.data());
+            draw_overlay(band, layout.masks, nthreads);
+            if (stats) {
+                timer.lap(*stats, stats->background);
+            }
+        }
+        ok = tiled ? output->write_tiles(spec.x, spec.x + spec.width, ybegin, yend, spec.z, spec.z + std::max(1, spec.depth), format, pixels.data())
+                   : output->write_scanlines(ybegin, yend, spec.z, format, pixels.data());
+        if (!ok) {
+            print_error("could not write output file: ", output->geterror());
+            output->close();
+            Filesystem::remove(tempfile, error);
+            return false;
+        }
+        if (stats) {
+            timer.lap(*stats, stats->write);
+        }
+    }
+    if (!output->close()) {
+        print_error("could not close output file: ", output->geterror());
+        Filesystem::remove(tempfile, error);
+        return false;
+    }
+    // burning in place replaces the plate, release it before the rename
+    if (!encoded) {
+        bool inplace = Filesystem::equivalent(card.inputfile, card.outputfile);
+        input.reset();
+        if (imagecache && inplace) {
+            imagecache->invalidate(inputname);
+        }
+        if (!replace_file(tempfile, card.outputfile)) {
+            return false;
+        }
+    }
+    if (stats) {
+        timer.lap(*stats, stats->write);
+    }
+    return true;
+}
+
+// writes rendered cards on background threads so that the next card renders
+// while the previous one is encoded. at most capacity cards are queued or
+// being written, submit blocks while the queue is full to bound memory
+class WriteQueue
+{
+public:
+    static WriteQueue& instance() {
+        static WriteQueue queue;
+        return queue;
+    }
+    
+    void open(int writers, int capacity) {
+        m_pool.reset(new JobPool(writers));
+        m_capacity = capacity;
+    }
+    
+    bool enabled() const { return m_pool != nullptr; }
+    
+    // queues imagebuf to be written to outputfile, written is called once the
+    // file is complete
+    void submit(std::unique_ptr<ImageBuf> imagebuf, const std::string& outputfile, CardStats* stats, std::function<void()> written) {
+        StageTimer timer(true);
+        size_t depth;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_available.wait(lock, [this] { return m_queued < m_capacity; });
+            depth = m_queued++;
+        }
+        if (stats) {
+            stats->queuedepth = depth;
+            timer.lap(*stats, stats->queue);
+        }
+        std::shared_ptr<ImageBuf> buffer(std::move(imagebuf));
+        m_pool->submit([this, buffer, outputfile, stats, written] {
+            StageTimer timer(true);
+            if (write_image(*buffer, outputfile)) {
+                if (stats) {
+                    timer.lap(*stats, stats->write);
+                }
+                if (written) {
+                    written();
+                }
+            } else {
+                m_failed++;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queued--;
+            }
+            m_available.notify_one();
+        });
+    }
+    
+    // waits until all queued cards are written, returns the number of failed
+    // writes
+    size_t wait() {
+        m_pool->wait();
+        return m_failed;
+    }
+
+private:
+    WriteQueue() : m_capacity(0), m_queued(0), m_failed(0) {}
+    
+    std::unique_ptr<JobPool> m_pool;
+    std::mutex m_mutex;
+    std::condition_variable m_available;
+    size_t m_capacity;
+    size_t m_queued;
+    std::atomic<size_t> m_failed;
+};
+
+// renders the card to its output file, or encodes it into memory using the
+// output file extension when encoded is set. with a canvas the card is drawn
+// incrementally over the previous frame of a sequence. written is called once
+// the output file is complete, with the write queue enabled that may be after
+// the card is returned
+static bool
+write_card(const TextCard& card, int nthreads, CardStats* stats, std::vector<unsigned char>* encoded,
+           FrameCanvas* canvas = nullptr, std::function<void()> written = nullptr)
+{
+    auto complete = [&written]() {
+        if (written) {
+            written();
+        }
+        return true;
+    };
+    if (encoded) {
+        print_info("Encoding title: ", card.outputfile);
+    } else {
+        print_info("Writing title file: ", card.outputfile);
+    }
+    if (card.inputfile.size()) {
+        return overlay_card(card, nthreads, stats, encoded) && complete();
+    }
+    ImageSpec spec(card.size.x, card.size.y, 4, output_format(card.outputfile));
+    if (output_bits(card.outputfile) == 10) {
+        spec.attribute("oiio:BitsPerSample", 10);
+    }
+    output_attributes(spec, card.outputfile);
+    
+    StageTimer timer(nthreads == 1);
+    CardLayout layout;
+    if (!layout_card(card, layout)) {
+        return false;
+    }
+    if (stats) {
+        stats->outputfile = card.outputfile;
+        timer.lap(*stats, stats->layout);
+    }
+    rasterize_card(layout, stats);
+    timer.restart();
+    
+    if (tool.stream > 0 && !encoded && !canvas) {
+        return stream_card(card, layout, spec, nthreads, stats) && complete();
+    }
+    
+    ImageBuf cardbuf;
+    ImageBuf& imagebuf = canvas ? canvas->imagebuf : cardbuf;
+    if (canvas && canvas->reusable(card, spec, layout)) {
+        draw_frame(*canvas, layout, nthreads, stats);
+    } else {
+        imagebuf.reset(spec);
+        if (stats) {
+            timer.lap(*stats, stats->alloc);
+        }
+        draw_card(imagebuf, layout, nthreads, stats);
+    }
+    if (canvas) {
+        canvas->gradient = card.gradient;
+        canvas->layout = layout;
+    }
+    timer.restart();
+    
+    // the canvas is drawn over by the next frame, queue a copy of it
+    WriteQueue& queue = WriteQueue::instance();
+    if (queue.enabled() && !encoded) {
+        std::unique_ptr<ImageBuf> buffer(new ImageBuf());
+        if (canvas) {
+            buffer->copy(imagebuf);
+        } else {
+            buffer->swap(cardbuf);
+        }
+        if (stats) {
+            timer.lap(*stats, stats->alloc);
+        }
+        queue.submit(std::move(buffer), card.outputfile, stats, written);
+        return true;
+    }
+    if (encoded) {
+        encoded->clear();
+        Filesystem::IOVecOutput output(*encoded);
+        imagebuf.set_write_ioproxy(&output);
+        if (!imagebuf.write(card.outputfile)) {
+            print_error("could not encode output file", imagebuf.geterror());
+            return false;
+        }
+    } else if (!write_image(imagebuf, card.outputfile)) {
+        return false;
+    }
+    if (stats) {
+        timer.lap(*stats, stats->write);
+    }
+    return complete();
+}
+
+// renders the card, identical cards are copied from the output cache
+static bool
+render_card(const TextCard& card, int nthreads, CardStats* stats = nullptr, std::vector<unsigned char>* encoded = nullptr,
+            FrameCanvas* canvas = nullptr)
+{
+    OutputCache& cache = OutputCache::instance();
+    if (encoded || !cache.enabled()) {
+        return write_card(card, nthreads, stats, encoded, canvas);
+    }
+    std::string cachefile = cache.path(card);
+    if (cache.fetch(cachefile, card.outputfile)) {
+        print_info("Using cached title file: ", card.outputfile);
+        if (stats) {
+            stats->outputfile = card.outputfile;
+            stats->peakrss = peak_rss();
+        }
+        return true;
+    }
+    std::string outputfile = card.outputfile;
+    return write_card(card, nthreads, stats, encoded, canvas, [cachefile, outputfile] {
+        OutputCache::instance().store(outputfile, cachefile);
+    });
+}
+
+// renders the frames begin to end of a sequence in order, drawn
+// incrementally on one canvas. with the plate cache the input plate of the
+// next frame is prefetched while the current frame is composited and
+// written. returns the number of frames that failed
+static int
+render_frames(const std::vector<TextCard>& cards, size_t begin, size_t end, int nthreads, std::vector<CardStats>& stats)
+{
+    PlateCache& plates = PlateCache::instance();
+    FrameCanvas canvas;
+    std::future<void> prefetch;
+    int failed = 0;
+    for (size_t i = begin; i < end; ++i) {
+        const std::string& inputfile = cards[i].inputfile;
+        if (plates.enabled() && i + 1 < end && cards[i + 1].inputfile.size() && cards[i + 1].inputfile != inputfile) {
+            prefetch = plates.prefetch(cards[i + 1].inputfile);
+        }
+        if (!render_card(cards[i], nthreads, stats.empty() ? nullptr : &stats[i], nullptr, &canvas)) {
+            failed++;
+        }
+        if (plates.enabled() && inputfile.size() && (i + 1 == end || cards[i + 1].inputfile != inputfile)) {
+            plates.release(inputfile);
+        }
+    }
+    return failed;
+}
+
+// serve
+#ifndef _WIN32
+static bool
+write_all(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+// handles one json request line. requests use the same fields as batch
+// manifests, with an outputfile the card is written to disk, without one it
+// is encoded in memory using encoding (default: png) and returned as payload.
+static std::string
+serve_request(const std::string& line, std::vector<unsigned char>& payload, bool& shutdown)
+{
+    Timer timer;
+    JsonValue request;
+    JsonParser parser(line);
+    if (!parser.parse(request) || request.type != JsonValue::Object) {
+        return "{ \"status\": \"error\", \"message\": \"" + json_escape(parser.error().size() ? parser.error() : "expected an object") + "\" }";
+    }
+    ManifestRow row = row_from_json(request);
+    if (row["command"] == "shutdown") {
+        shutdown = true;
+        return "{ \"status\": \"ok\" }";
+    }
+    bool memory = !row.count("outputfile") && !row.count("output");
+    if (memory) {
+        std::string encoding = row.count("encoding") ? row["encoding"] : "png";
+        row["outputfile"] = "card." + encoding;
+    }
+    TextCard card;
+    std::string error;
+    if (!card_from_row(row, card, error)) {
+        return "{ \"status\": \"error\", \"message\": \"" + json_escape(error) + "\" }";
+    }
+    if (card.size.x > tool.servemaxsize.x || card.size.y > tool.servemaxsize.y) {
+        std::ostringstream oss;
+        oss << "size must be within " << tool.servemaxsize.x << ", " << tool.servemaxsize.y;
+        return "{ \"status\": \"error\", \"message\": \"" + json_escape(oss.str()) + "\" }";
+    }
+    if (!render_card(card, tool.threads, nullptr, memory ? &payload : nullptr)) {
+        return "{ \"status\": \"error\", \"message\": \"could not render card\" }";
+    }
+    std::ostringstream oss;
+    oss << "{ \"status\": \"ok\", ";
+    if (memory) {
+        oss << "\"bytes\": " << payload.size() << ", ";
+    } else {
+        oss << "\"outputfile\": \"" << json_escape(card.outputfile) << "\", ";
+    }
+    oss << "\"elapsed_ms\": " << 1000.0 * timer() << " }";
+    return oss.str();
+}
+
+// request lines longer than this close the connection
+static const size_t serve_max_request = 1024 * 1024;
+
+// reads newline separated requests and answers each with a json line,
+// followed by the encoded image bytes for in memory requests. runs on its own
+// thread doing only i/o, each request is rendered on pool so that idle
+// clients never hold a render thread
+static void
+serve_connection(int fd, JobPool& pool, std::atomic<bool>& running)
+{
+    std::string buffer;
+    char data[4096];
+    while (running) {
+        size_t newline = buffer.find('\n');
+        if (newline == std::string::npos) {
+            if (buffer.size() > serve_max_request) {
+                std::string response = "{ \"status\": \"error\", \"message\": \"request is too long\" }\n";
+                write_all(fd, response.data(), response.size());
+                break;
+            }
+            pollfd request = { fd, POLLIN, 0 };
+            if (::poll(&request, 1, 100) == 0) {
+                continue;
+            }
+            ssize_t size = ::read(fd, data, sizeof(data));
+            if (size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (size <= 0) {
+                break;
+            }
+            buffer.append(data, size);
+            continue;
+        }
+        std::string line = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        if (Strutil::trimmed_whitespace(line).empty()) {
+            continue;
+        }
+        std::vector<unsigned char> payload;
+        bool shutdown = false;
+        std::string response;
+        std::promise<void> rendered;
+        std::future<void> done = rendered.get_future();
+        pool.submit([&] {
+            response = serve_request(line, payload, shutdown) + "\n";
+            rendered.set_value();
+        });
+        done.wait();
+        if (!write_all(fd, response.data(), response.size())
+            || (payload.size() && !write_all(fd, payload.data(), payload.size()))) {
+            break;
+        }
+        if (shutdown) {
+            running = false;
+        }
+    }
+    ::close(fd);
+}
+
+// a client connection served on its own thread
+struct ServeConnection
+{
+    std::thread thread;
+    std::atomic<bool> done;
+    
+    ServeConnection() : done(false) {}
+};
+
+// keeps fonts, glyphs and image writer plugins warm between requests
+static void
+serve_warmup()
+{
+    int height = tool.size.y;
+    std::string glyphs;
+    for (char c = 32; c < 127; ++c) {
+        glyphs += c;
+    }
+    const int sizes[] = { static_cast<int>(height * 0.2), static_cast<int>(height * 0.1) };
+    for (int size : sizes) {
+        if (std::shared_ptr<FontFace> font = FontRegistry::instance().face(tool.fontfile, size)) {
+            shape_text(glyphs, *font);
+        }
+    }
+    const char* formats[] = { "warmup.png", "warmup.jpg", "warmup.exr", "warmup.tif" };
+    for (const char* format : formats) {
+        ImageOutput::create(format);
+    }
+}
+#endif
+
+// serves render requests over a unix domain socket until shutdown
+static bool
+serve(const std::string& socketpath)
+{
+#ifndef _WIN32
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketpath.size() >= sizeof(address.sun_path)) {
+        print_error("socket path is too long: ", socketpath);
+        return false;
+    }
+    std::strncpy(address.sun_path, socketpath.c_str(), sizeof(address.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        print_error("could not create socket: ", std::strerror(errno));
+        return false;
+    }
+    ::unlink(socketpath.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        print_error("could not listen on socket: ", std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    serve_warmup();
+    print_info("Serving requests on socket: ", socketpath);
+    
+    std::atomic<bool> running(true);
+    {
+        JobPool pool(tool.threads);
+        std::list<ServeConnection> connections;
+        while (running) {
+            for (std::list<ServeConnection>::iterator it = connections.begin(); it != connections.end();) {
+                if (it->done) {
+                    it->thread.join();
+                    it = connections.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            pollfd request = { fd, POLLIN, 0 };
+            int ready = ::poll(&request, 1, 100);
+            if (ready <= 0) {
+                continue;
+            }
+            int connection = ::accept(fd, nullptr, nullptr);
+            if (connection < 0) {
+                continue;
+            }
+            connections.emplace_back();
+            ServeConnection& client = connections.back();
+            client.thread = std::thread([connection, &pool, &running, &client] {
+                serve_connection(connection, pool, running);
+                client.done = true;
+            });
+        }
+        for (ServeConnection& client : connections) {
+            client.thread.join();
+        }
+    }
+    ::close(fd);
+    ::unlink(socketpath.c_str());
+    return true;
+#else
+    print_error("serve is not supported on this platform: ", socketpath);
+    return false;
+#endif
+}
+
+// benchmark
+struct BenchScenario
+{
+    std::string name;
+    TextCard card;
+};
+
+// per pixel setpixel on a single thread, the original gradient loop, kept as
+// baseline for the gradient benchmarks
+static void
+draw_gradient_setpixel(ImageBuf& imagebuf, ROI roi, Imath::Vec3<float> startcolor, Imath::Vec3<float> endcolor)
+{
+    for (int y = roi.ybegin; y < roi.yend; ++y) {
+        float blend = static_cast<float>(y - roi.ybegin) / std::max(1, roi.height() - 1);
+        float r = (1 - blend) * startcolor[0] + blend * endcolor[0];
+        float g = (1 - blend) * startcolor[1] + blend * endcolor[1];
+        float b = (1 - blend) * startcolor[2] + blend * endcolor[2];
+        for (int x = roi.xbegin; x < roi.xend; ++x) {
+            imagebuf.setpixel(x, y, {r, g, b, 1.0f});
+        }
+    }
+}
+
+// per row float blend converted on store, the gradient loop prior to the
+// lut engine, kept as baseline for the gradient benchmarks
+static void
+draw_gradient_reference(ImageBuf& imagebuf, ROI roi, Imath::Vec3<float> startcolor, Imath::Vec3<float> endcolor, int nthreads)
+{
+    int nchannels = imagebuf.nchannels();
+    float range = static_cast<float>(std::max(1, roi.height() - 1));
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI band) {
+        std::vector<float> row(size_t(band.width()) * nchannels, 1.0f);
+        for (int y = band.ybegin; y < band.yend; ++y) {
+            float blend = static_cast<float>(y - roi.ybegin) / range;
+            for (size_t x = 0; x < size_t(band.width()); ++x) {
+                for (int c = 0; c < std::min(nchannels, 3); ++c) {
+                    row[x * nchannels + c] = (1 - blend) * startcolor[c] + blend * endcolor[c];
+                }
+            }
+            imagebuf.set_pixels(ROI(band.xbegin, band.xend, y, y + 1, 0, 1, 0, nchannels), TypeFloat, row.data());
+        }
+    });
+}
+
+// times the gradient lut engine against the setpixel and per row reference
+// loops per pixel type
+static void
+run_gradient_benchmark(std::ostream& json, int repeat)
+{
+    const Imath::Vec3<float> startcolor(0.1f, 0.2f, 0.6f);
+    const Imath::Vec3<float> endcolor(0.02f, 0.05f, 0.15f);
+    const std::vector<std::pair<std::string, Imath::Vec2<int>>> sizes = {
+        { "4k", Imath::Vec2<int>(4096, 2304) },
+        { "8k", Imath::Vec2<int>(8192, 4608) }
+    };
+    const std::vector<TypeDesc> formats = { TypeDesc::UINT8, TypeDesc::UINT16, TypeDesc::HALF, TypeDesc::FLOAT };
+    json << "  \"gradients\": [\n";
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        for (size_t f = 0; f < formats.size(); ++f) {
+            ImageBuf imagebuf(ImageSpec(sizes[i].second.x, sizes[i].second.y, 4, formats[f]));
+            double setpixel = 0.0;
+            double reference = 0.0;
+            double lut = 0.0;
+            for (int r = 0; r < repeat; ++r) {
+                Timer timer;
+                draw_gradient_setpixel(imagebuf, imagebuf.roi(), startcolor, endcolor);
+                setpixel += timer.lap();
+                draw_gradient_reference(imagebuf, imagebuf.roi(), startcolor, endcolor, tool.threads);
+                reference += timer.lap();
+                draw_gradient(imagebuf, imagebuf.roi(), startcolor, endcolor, tool.threads);
+                lut += timer.lap();
+            }
+            bool last = i + 1 == sizes.size() && f + 1 == formats.size();
+            json << "    {"
+                 << " \"name\": \"gradient/" << sizes[i].first << "\","
+                 << " \"format\": \"" << formats[f].c_str() << "\","
+                 << " \"setpixel_ms\": " << 1000.0 * setpixel / repeat << ","
+                 << " \"reference_ms\": " << 1000.0 * reference / repeat << ","
+                 << " \"lut_ms\": " << 1000.0 * lut / repeat << ","
+                 << " \"speedup\": " << (lut > 0.0 ? reference / lut : 0.0) << ","
+                 << " \"setpixel_speedup\": " << (lut > 0.0 ? setpixel / lut : 0.0)
+                 << " }" << (last ? "" : ",") << "\n";
+        }
+    }
+    json << "  ],\n";
+}
+
+// runs fixed scenarios and writes per stage timings and throughput as json
+static bool
+run_benchmark(const std::string& jsonfile)
+{
+    const int repeat = 3;
+    const std::string shorttitle = "v001";
+    const std::string longtitle = "SHOW_010_0420_comp_v001 - Final Delivery";
+    std::string directory = Filesystem::temp_directory_path() + "/texttool_bench";
+    std::string error;
+    if (!Filesystem::exists(directory) && !Filesystem::create_directory(directory, error)) {
+        print_error("could not create benchmark directory: ", error);
+        return false;
+    }
+    
+    std::vector<BenchScenario> scenarios;
+    auto scenario = [&](const std::string& name, const std::string& gradient, Imath::Vec2<int> size,
+                        const std::string& title, const std::string& extension) {
+        BenchScenario scenario;
+        scenario.name = name;
+        scenario.card.title = title;
+        scenario.card.subtitle = "texttool benchmark";
+        scenario.card.gradient = gradient;
+        scenario.card.size = size;
+        scenario.card.outputfile = directory + "/" + Strutil::replace(name, "/", "_", true) + extension;
+        scenarios.push_back(scenario);
+    };
+    Imath::Vec2<int> uhd(3840, 2160);
+    scenario("background/solid", "", uhd, shorttitle, ".png");
+    for (const std::pair<const std::string, float>& pair : gradient_hues()) {
+        scenario("background/" + pair.first, pair.first, uhd, shorttitle, ".png");
+    }
+    scenario("background/horizontal", "horizontal:azure", uhd, shorttitle, ".png");
+    scenario("background/diagonal", "diagonal:azure", uhd, shorttitle, ".png");
+    scenario("background/radial", "radial:#ffffff,#203040", uhd, shorttitle, ".png");
+    scenario("background/multistop", "30:#000000,#ff8800@0.4,#ffffff@0.6,#000000", uhd, shorttitle, ".png");
+    scenario("size/8k-radial", "radial:#ffffff,#203040", Imath::Vec2<int>(8192, 4608), shorttitle, ".exr");
+    scenario("size/1k", "azure", Imath::Vec2<int>(1024, 576), shorttitle, ".png");
+    scenario("size/4k", "azure", Imath::Vec2<int>(4096, 2304), shorttitle, ".png");
+    scenario("size/8k", "azure", Imath::Vec2<int>(8192, 4608), shorttitle, ".png");
+    scenario("size/16k", "azure", Imath::Vec2<int>(16384, 9216), shorttitle, ".png");
+    scenario("title/short", "azure", uhd, shorttitle, ".png");
+    scenario("title/long", "azure", uhd, longtitle, ".png");
+    scenario("output/png", "azure", uhd, shorttitle, ".png");
+    scenario("output/exr", "azure", uhd, shorttitle, ".exr");
+    scenario("output/tif", "azure", uhd, shorttitle, ".tif");
+    
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"threads\": " << tool.threads << ",\n"
+         << "  \"repeat\": " << repeat << ",\n";
+    run_gradient_benchmark(json, repeat);
+    json << "  \"scenarios\": [\n";
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        const BenchScenario& scenario = scenarios[i];
+        CardStats stats;
+        for (int r = 0; r < repeat; ++r) {
+            if (!write_card(scenario.card, tool.threads, &stats, nullptr)) {
+                return false;
+            }
+        }
+        std::string error;
+        Filesystem::remove(scenario.card.outputfile, error);
+        double total = stats.total() / repeat;
+        json << "    {\n"
+             << "      \"name\": \"" << scenario.name << "\",\n"
+             << "      \"size\": [" << scenario.card.size.x << ", " << scenario.card.size.y << "],\n"
+             << "      \"format\": \"" << output_format(scenario.card.outputfile).c_str() << "\",\n"
+             << "      \"stages_ms\": {"
+             << " \"alloc\": " << 1000.0 * stats.alloc.wall / repeat << ","
+             << " \"background\": " << 1000.0 * stats.background.wall / repeat << ","
+             << " \"layout\": " << 1000.0 * stats.layout.wall / repeat << ","
+             << " \"render_text\": " << 1000.0 * stats.text() / repeat << ","
+             << " \"write\": " << 1000.0 * stats.write.wall / repeat << " },\n"
+             << "      \"total_ms\": " << 1000.0 * total << ",\n"
+             << "      \"cards_per_sec\": " << (total > 0.0 ? 1.0 / total : 0.0) << "\n"
+             << "    }" << (i + 1 < scenarios.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n"
+         << "}\n";
+    
+    std::ofstream file(jsonfile);
+    if (!file) {
+        print_error("could not write benchmark file: ", jsonfile);
+        return false;
+    }
+    file << json.str();
+    print_info("Writing benchmark file: ", jsonfile);
+    return true;
+}
+
+// main
+int 
+main( int argc, const char * argv[])
+{
+    // Helpful for debugging to make sure that any crashes dump a stack
+    // trace.
+    Sysutil::setup_crash_stacktrace("stdout");
+
+    Filesystem::convert_native_arguments(argc, (const char**)argv);
+    ArgParse ap;
+
+    ap.intro("texttool -- a utility for creating text in images\n");
+    ap.usage("texttool [options] ...")
+      .add_help(false)
+      .exit_on_error(true);
+    
+    ap.separator("General flags:");
+    ap.arg("--help", &tool.help)
+      .help("Print help message");
     
     ap.arg("-v", &tool.verbose)
       .help("Verbose status messages");
@@ -227,18 +4404,109 @@ main( int argc, const char * argv[])
       .action(set_subtitle);
     
     ap.arg("--gradient %s:GRADIENT")
-      .help("Set gradient")
+      .help("Set gradient: hue or [mode:]color[@position],... (mode: vertical, horizontal, diagonal, radial, degrees)")
       .action(set_gradient);
     
     ap.arg("--size %s:SIZE")
       .help("Set size (default: 1024, 1024)")
       .action(set_size);
     
+    ap.arg("--inputfile %s:INPUTFILE")
+      .help("Composite text onto an existing image instead of a new canvas")
+      .action(set_inputfile);
+    
+    ap.arg("--template %s:TEMPLATEFILE")
+      .help("Lay out text blocks from a json template instead of title and subtitle")
+      .action(set_template);
+    
+    ap.arg("--field %s:KEY=VALUE")
+      .help("Set template field, may be repeated")
+      .action(set_field);
+    
+    ap.arg("--batch %s:BATCHFILE")
+      .help("Render cards from manifest (csv or json)")
+      .action(set_batch);
+    
+    ap.arg("--sequence %s:START-END")
+      .help("Render a frame sequence, substituting %04d, {frame} and {timecode} in title, subtitle and output file")
+      .action(set_sequence);
+    
+    ap.arg("--fps %d:FPS")
+      .help("Set sequence frame rate for timecode (default: 24)")
+      .action(set_fps);
+    
+    ap.arg("--threads %d:THREADS")
+      .help("Set number of threads (default: hardware concurrency)")
+      .action(set_threads);
+    
+    ap.arg("--glyphcache %d:MB")
+      .help("Set glyph cache memory budget in MB (default: 64)")
+      .action(set_glyphcache);
+    
+    ap.arg("--layercache %d:MB")
+      .help("Set template layer cache memory budget in MB (default: 64)")
+      .action(set_layercache);
+    
+    ap.arg("--benchmark %s:JSONFILE")
+      .help("Run benchmark scenarios and write timings as json")
+      .action(set_benchmark);
+    
+    ap.arg("--stats-json %s:JSONFILE")
+      .help("Write per stage timings and peak memory as json")
+      .action(set_statsfile);
+    
+    ap.arg("--serve %s:SOCKET")
+      .help("Serve render requests over a unix domain socket")
+      .action(set_serve);
+    
+    ap.arg("--serve-max-size %s:SIZE")
+      .help("Set largest card size a serve request may render (default: 16384, 16384)")
+      .action(set_serve_max_size);
+    
+    ap.arg("--cache-dir %s:DIRECTORY")
+      .help("Reuse identical output files from a content addressed cache")
+      .action(set_cachedir);
+    
+    ap.arg("--cache-size %d:MB")
+      .help("Set output cache size limit in MB (default: 1024)")
+      .action(set_cachesize);
+    
+    ap.arg("--plate-cache-memory %d:MB")
+      .help("Set image cache memory for input plates of sequences in MB (default: 512)")
+      .action(set_platememory);
+    
+    ap.arg("--plate-cache-files %d:FILES")
+      .help("Set image cache open file limit for input plates of sequences (default: 100)")
+      .action(set_platefiles);
+    
     ap.separator("Output flags:");
     ap.arg("--outputfile %s:OUTPUTFILE")
       .help("Set output file")
       .action(set_outputfile);
     
+    ap.arg("--format %s:FORMAT")
+      .help("Set render format: uint8, uint10, uint16, half, float (default: from output file)")
+      .action(set_format);
+    
+    ap.arg("--compression %s:COMPRESSION")
+      .help("Set output compression: fast, small or a format compression such as zip:6, zips, piz, none (default: format default)")
+      .action(set_compression);
+    
+    ap.arg("--quality %d:QUALITY")
+      .help("Set lossy output compression quality from 1 to 100 (default: format default)")
+      .action(set_quality);
+    
+    ap.arg("--dither", &tool.dither)
+      .help("Ordered dither gradients in 8 and 10 bit output to avoid banding");
+    
+    ap.arg("--write-queue %d:CARDS")
+      .help("Encode and write in the background with up to this many cards queued per thread (default: 1, 0 writes in place)")
+      .action(set_writequeue);
+    
+    ap.arg("--stream %d:ROWS")
+      .help("Render and write in bands of rows to bound memory (default: 0, off)")
+      .action(set_stream);
+    
     // clang-format on
     if (ap.parse_args(argc, (const char**)argv) < 0) {
         print_error(ap.geterror());
@@ -252,8 +4520,8 @@ main( int argc, const char * argv[])
         return EXIT_SUCCESS;
     }
     
-    if (!tool.outputfile.size()) {
-        print_error("must have output file parameter");
+    if (!tool.outputfile.size() && !tool.batchfile.size() && !tool.benchmarkfile.size() && !tool.serve.size()) {
+        print_error("must have output file or batch file parameter");
         ap.briefusage();
         ap.abort();
         return EXIT_FAILURE;
@@ -266,127 +4534,192 @@ main( int argc, const char * argv[])
 
     // texttool program
     print_info("texttool -- a utility for creating text in images");
-
-    print_info("Writing title file: ", tool.outputfile);
-    ImageSpec spec(tool.size.x, tool.size.y, 4, TypeDesc::FLOAT);
-    ImageBuf imagebuf(spec);
-
-    // title
-    ROI roi(0, tool.size.x, 0, tool.size.y);
-    int height = roi.height();
-    int titlesize = height * 0.2;
-    int subtitlesize = height * 0.1;
-    int center = roi.ybegin + height / 2;
-    int spacing = height * 0.08;
-
-    // font
-    std::string font = "Roboto.ttf";
-
-    float hue = 49;
     
-    // background
-    bool found = false;
-    if (tool.gradient.size() > 0)
-    {
-        std::map<std::string, float> hues;
-        hues["red"] = 360.0f;
-        hues["orange"] = 30.0f;
-        hues["yellow"] = 60.0f;
-        hues["green"] = 120.0f;
-        hues["cyan"] = 180.0f;
-        hues["azure"] = 210.0f;
-        hues["blue"] = 240.0f;
-        hues["violet"] = 270.0f;
-        hues["magenta"] = 300.0f;
-        hues["rose"] = 330.0f;
-        std::map<std::string, float>::iterator it = hues.find(tool.gradient);
-        if (it != hues.end()) {
-            float hue = it->second;
-            Imath::Vec3<float> a = rgb_from_hsv(Imath::Vec3<float>(hue, 0.9, 0.5));
-            draw_gradient(
-                    imagebuf,
-                    roi,
-                    rgb_from_hsv(Imath::Vec3<float>(hue, 1.0, 0.5)),
-                    rgb_from_hsv(Imath::Vec3<float>(hue, 0.5, 0.8))
-            );
-            found = true;
-        } else {
-            print_warning("could not find hue for gradient: ", tool.gradient);
-            std::string options;
-            for (const std::pair<const std::string, float>& pair : hues) {
-                if (options.size()) {
-                    options += ", ";
-                }
-                options += pair.first;
-            }
-            print_warning("available options are: ", options);
+    // font, resolved once and shared by all cards
+    tool.fontfile = font_path(tool.font);
+    
+    // template, compiled once and shared by all cards
+    if (tool.templatefile.size()) {
+        tool.plan = read_template(tool.templatefile);
+        if (!tool.plan) {
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // glyphs
+    GlyphCache::instance().set_budget(size_t(tool.glyphcache) * 1024 * 1024);
+    LayerCache::instance().set_budget(size_t(tool.layercache) * 1024 * 1024);
+    
+    // cache
+    if (tool.cachedir.size()) {
+        if (!OutputCache::instance().open(tool.cachedir, size_t(tool.cachesize) * 1024 * 1024)) {
+            return EXIT_FAILURE;
         }
     }
     
-    if (!found) {
-        ImageBufAlgo::fill(
-                imagebuf,
-                { tool.background.x, tool.background.y, tool.background.z, 1.0f },
-                roi
-        );
+    // threads
+    if (!tool.threads) {
+        tool.threads = std::max(1u, Sysutil::hardware_concurrency());
     }
+    OIIO::attribute("threads", tool.threads);
     
-    // center
-    int titley, subtitley;
-    {
-        ROI titleroi = ImageBufAlgo::text_size(tool.title, titlesize, font_path(font));
-        ROI subtitleroi = ImageBufAlgo::text_size(tool.title, subtitlesize, font_path(font));
-        int textheight = titleroi.height() + spacing + subtitleroi.height();
-        titley = center - (textheight / 2);
-        subtitley = titley + titleroi.height() + spacing;
+    // encoders, exr and tiff compress blocks of scanlines on multiple threads
+    OIIO::attribute("exr_threads", tool.threads);
+    OIIO::attribute("tiff:multithread", 1);
+    
+    // benchmark
+    if (tool.benchmarkfile.size()) {
+        return run_benchmark(tool.benchmarkfile) ? EXIT_SUCCESS : EXIT_FAILURE;
     }
     
-    // title
-    {
+    // serve
+    if (tool.serve.size()) {
+        return serve(tool.serve) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    // cards
+    std::vector<TextCard> cards;
+    if (tool.batchfile.size()) {
+        if (!read_manifest(tool.batchfile, cards)) {
+            return EXIT_FAILURE;
+        }
+        print_info("Rendering cards from batch file: ", tool.batchfile);
+    } else {
+        TextCard card;
+        card.title = tool.title;
+        card.subtitle = tool.subtitle;
+        card.gradient = tool.gradient;
+        card.outputfile = tool.outputfile;
+        card.inputfile = tool.inputfile;
+        card.size = tool.size;
+        card.fields = tool.fields;
+        cards.push_back(card);
+    }
+    if (tool.sequence) {
+        cards = sequence_cards(cards, tool.frames, tool.fps);
         std::ostringstream oss;
-        oss << "size: "
-            << tool.size.x
-            << ", "
-            << tool.size.y
-            << " ";
-
-        ImageBufAlgo::render_text(
-            imagebuf,
-            roi.xbegin + roi.width() / 2, // Center horizontally
-            titley,
-            tool.title,
-            titlesize,
-            font_path(font),
-            { tool.color.x, tool.color.y, tool.color.z, 1.0f },
-            ImageBufAlgo::TextAlignX::Center,
-            ImageBufAlgo::TextAlignY::Top
-        );
-    }
-    
-    // subtitle
-    {
+        oss << tool.frames.x << " - " << tool.frames.y << " at " << tool.fps << " fps";
+        print_info("Rendering sequence frames: ", oss.str());
+        
+        // every frame needs its own output file, frames without a plate are
+        // drawn incrementally on a full canvas and can not be streamed
+        std::map<std::string, int> outputs;
+        bool plates = false;
+        for (const TextCard& card : cards) {
+            if (!outputs.insert(std::make_pair(card.outputfile, 0)).second) {
+                print_error("sequence output file must differ per frame, use %04d or {frame}: ", card.outputfile);
+                return EXIT_FAILURE;
+            }
+            if (card.inputfile.size()) {
+                plates = true;
+            } else if (tool.stream > 0) {
+                print_error("--stream is not supported for sequences without an input file");
+                return EXIT_FAILURE;
+            }
+        }
+        if (plates) {
+            PlateCache::instance().open(tool.platememory, tool.platefiles);
+        }
+    }
+    if (tool.plan) {
+        tool.plan = constant_blocks(*tool.plan, cards);
+    }
+    
+    // stats
+    bool collect = tool.verbose || tool.statsfile.size();
+    std::vector<CardStats> stats(collect ? cards.size() : 0);
+    Timer timer;
+    
+    // cards rendered in parallel fill single threaded, a single card uses all threads
+    int threads = std::min(tool.threads, static_cast<int>(cards.size()));
+    
+    // writes, each render thread hands finished cards to its own writer
+    if (tool.writequeue > 0) {
+        WriteQueue::instance().open(std::max(1, threads), std::max(1, threads) * tool.writequeue);
+    }
+    if (threads > 1) {
+        print_info("Rendering cards using threads: ", threads);
+        std::atomic<int> failed(0);
+        JobPool pool(threads);
+        if (tool.sequence) {
+            // frames are split into one contiguous run per thread, each drawn
+            // incrementally on its own canvas
+            size_t run = (cards.size() + threads - 1) / threads;
+            for (size_t begin = 0; begin < cards.size(); begin += run) {
+                size_t end = std::min(cards.size(), begin + run);
+                pool.submit([&failed, &cards, &stats, begin, end] {
+                    failed += render_frames(cards, begin, end, 1, stats);
+                });
+            }
+        } else {
+            for (size_t i = 0; i < cards.size(); ++i) {
+                pool.submit([&failed, &cards, &stats, collect, i] {
+                    if (!render_card(cards[i], 1, collect ? &stats[i] : nullptr)) {
+                        failed++;
+                    }
+                });
+            }
+        }
+        pool.wait();
+        if (failed > 0) {
+            tool.code = EXIT_FAILURE;
+        }
+    } else if (tool.sequence) {
+        if (render_frames(cards, 0, cards.size(), tool.threads, stats) > 0) {
+            tool.code = EXIT_FAILURE;
+        }
+    } else {
+        for (size_t i = 0; i < cards.size(); ++i) {
+            if (!render_card(cards[i], tool.threads, collect ? &stats[i] : nullptr)) {
+                tool.code = EXIT_FAILURE;
+            }
+        }
+    }
+    if (WriteQueue::instance().enabled() && WriteQueue::instance().wait() > 0) {
+        tool.code = EXIT_FAILURE;
+    }
+    double elapsed = timer();
+    
+    if (tool.verbose) {
+        for (const CardStats& card : stats) {
+            print_stats(card);
+        }
+    }
+    if (tool.statsfile.size()) {
+        if (!write_stats(tool.statsfile, stats, elapsed)) {
+            tool.code = EXIT_FAILURE;
+        }
+    }
+    
+    if (tool.verbose) {
+        const GlyphCache& glyphcache = GlyphCache::instance();
         std::ostringstream oss;
-        oss << "size: "
-            << tool.size.x
-            << ", "
-            << tool.size.y
-            << " ";
-            
-        ImageBufAlgo::render_text(
-            imagebuf,
-            roi.xbegin + roi.width() / 2, // Center horizontally
-            subtitley,
-            tool.subtitle,
-            subtitlesize,
-            font_path(font),
-            { tool.color.x, tool.color.y, tool.color.z, 1.0f },
-            ImageBufAlgo::TextAlignX::Center,
-            ImageBufAlgo::TextAlignY::Top
-        );
-    }
-    
-    if (!imagebuf.write(tool.outputfile)) {
-        print_error("could not write output file", imagebuf.geterror());
+        oss << "hits: " << glyphcache.hits()
+            << ", misses: " << glyphcache.misses()
+            << ", hit rate: " << static_cast<int>(glyphcache.hitrate() * 100.0f) << "%"
+            << ", memory: " << glyphcache.memory() / 1024 << " KB";
+        print_info("Glyph cache ", oss.str());
+        if (OutputCache::instance().enabled()) {
+            const OutputCache& outputcache = OutputCache::instance();
+            std::ostringstream oss;
+            oss << "hits: " << outputcache.hits()
+                << ", misses: " << outputcache.misses();
+            print_info("Output cache ", oss.str());
+        }
+        if (tool.plan) {
+            const LayerCache& layercache = LayerCache::instance();
+            std::ostringstream oss;
+            oss << "hits: " << layercache.hits()
+                << ", misses: " << layercache.misses()
+                << ", memory: " << layercache.memory() / 1024 << " KB";
+            print_info("Template layer cache ", oss.str());
+        }
+        if (PlateCache::instance().enabled()) {
+            print_info("Plate cache prefetched frames: ", PlateCache::instance().prefetches());
+            if (tool.debug) {
+                print_info("Plate cache statistics:\n", PlateCache::instance().imagecache()->getstats());
+            }
+        }
     }
-    return 0;
+    return tool.code;
 }